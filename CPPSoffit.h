@@ -33,13 +33,69 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 #include <string>
 #include <iostream>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <regex>
+#include <memory>
+#include <chrono>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <string_view>
 
 /**
  * The CPPSoffit namespace
  */
 namespace CPPSoffit {
 
+    const std::string SOFFIT_START = "__SoffitStart";
+    const std::string SOFFIT_END = "__SoffitEnd";
+    const char ESCAPE_SEQUENCE = '\\';
+    const std::string SOFFIT_DELETE = "__SoffitDelete";
+    const std::string SOFFIT_JSON_NAME = "__SoffitName";
+
+    class SoffitObject;
     class SoffitField;
+    class SoffitParseContext;
+    class SoffitIndex;
+    class SoffitThreadPool;
+    struct SoffitThreadPoolTask;
+    class SoffitImage;
+    struct SoffitError;
+    enum class SoffitMergePolicy;
+
+    /**
+     * A view of objects found by a recursive query, in document order.
+     * Nothing is copied; the range points into the document's index, so it is invalidated by any change to the document.
+     */
+    class SoffitObjectRange {
+    private:
+        SoffitObject* const* first = nullptr;
+        SoffitObject* const* last = nullptr;
+
+    public:
+        SoffitObjectRange();
+        SoffitObjectRange(SoffitObject* const* first, SoffitObject* const* last);
+
+        SoffitObject* const* begin() const;
+        SoffitObject* const* end() const;
+
+        /**
+         * Returns the number of objects in the range.
+         */
+        size_t size() const;
+
+        /**
+         * Returns true if the query found nothing.
+         */
+        bool empty() const;
+
+        SoffitObject* operator[](size_t i) const;
+    };
 
     class SoffitObject {
     private:
@@ -49,11 +105,67 @@ namespace CPPSoffit {
         std::vector<SoffitField*> fields;
         std::vector<SoffitObject*> objects;
         int nestingLevel = -1;
-        const int initialVectorCapacity = 5;
 
+        //Serialized fields and child objects kept by WriteStreamCached, one text per indent mode
+        struct WriteCache {
+            std::string text[2];
+            int nestingLevel = 0;
+        };
+
+        //Location of this object's unparsed body when it was read lazily
+        struct LazyBody {
+            std::shared_ptr<const std::string> source;
+            size_t begin;
+            size_t end;
+            int lineNumber;
+        };
+
+        //State used by only some features, allocated by getExtras on first use so that a plain tree does not carry it
+        struct Extras {
+            //Cached by getHash(), and invalidated up the parent chain by every mutator.
+            //Atomic so that field changes made by ParallelForEach callbacks can invalidate shared ancestors at once.
+            std::atomic<bool> hashValid{ false };
+
+            //A bit is set for each indent mode whose text in writeCache is current, cleared along with the hash
+            std::atomic<unsigned char> writeValid{ 0 };
+
+            uint64_t hash = 0;
+            WriteCache* writeCache = nullptr;
+
+            //Position of this object in document order, and the index owned by a root object, while its document is indexed
+            uint64_t order = 0;
+            SoffitIndex* index = nullptr;
+
+            //Null once the body is parsed
+            LazyBody* lazyBody = nullptr;
+        };
+        Extras* extras = nullptr;
+
+        Extras* getExtras();
+        void resetCaches();
+        void parseLazyBody();
         void calculateNestingLevel();
+        void recursivelyCalculateNestingLevel();
         void setParent(SoffitObject* p);
-        void reserveInitialVectorCapacity();
+        void invalidateHash();
+        const std::string& serializedBody(bool indent);
+        SoffitIndex* documentIndex();
+        void unindex(SoffitObject* child);
+        void dropIndex();
+        size_t memoryUsage(std::vector<const std::string*>& sources);
+
+        friend class SoffitField;
+        friend void _diffObjects(SoffitObject* from, SoffitObject* to, const std::string& path, SoffitObject* patch);
+        friend void _applyEdit(SoffitObject* target, SoffitObject* edit);
+        friend SoffitObject* _resolvePatchPath(SoffitObject* root, const std::string& path);
+        friend void _mergeObjects(SoffitObject* base, SoffitObject* overlay, SoffitMergePolicy policy);
+        friend void Merge(SoffitObject* base, SoffitObject* overlay, SoffitMergePolicy policy);
+        friend bool _readStreamInto(SoffitObject* root, std::istream& stream, SoffitParseContext& context, SoffitError& error);
+        friend class SoffitParseContext;
+        friend class SoffitIndex;
+        friend class SoffitReloader;
+        friend void _visitObjects(SoffitThreadPool& pool, const SoffitThreadPoolTask& task);
+        friend void WriteStreamCached(SoffitObject* root, std::ostream& output, bool indent);
 
     public:
         /**
@@ -133,6 +245,16 @@ namespace CPPSoffit {
          */
         SoffitField* getField(std::string fieldName);
 
+        /**
+         * Gets the value of a contained field, converted to the requested type.
+         * Supported types are int, int64_t, double, and bool.
+         * Returns defaultValue if the field is not found or its value can not be converted.
+         * @param fieldName
+         * @param defaultValue
+         */
+        template<typename T>
+        T getFieldAs(std::string fieldName, T defaultValue);
+
         /**
          * Returns true if this object contains a field with the name specified.
          */
@@ -245,6 +367,13 @@ namespace CPPSoffit {
          */
         void detachObject(std::string name);
 
+        /**
+         * Detaches the specified child object from this object.
+         * This does not delete/deallocate the specified object.
+         * This does nothing if the object is not a child of this object.
+         */
+        void detachObject(SoffitObject* child);
+
         /**
          * Detaches the specified child objects by type from this object.
          * This does not delete/deallocate the specified objects.
@@ -280,6 +409,78 @@ namespace CPPSoffit {
          * This does nothing if this object has no fields.
          */
         void detachAllFields();
+
+        /**
+         * Detaches this object from its parent, making it a root object.
+         * This does nothing if this object is already a root object.
+         */
+        void detachFromParant();
+
+        /**
+         * Releases spare capacity held by this object, its fields and all of its descendants.
+         * Useful after parsing or heavy editing of a document that will be kept for a long time.
+         * Objects whose bodies have not been parsed yet are left untouched.
+         */
+        void shrinkToFit();
+
+        /**
+         * Returns the number of bytes used by this object, its fields and all of its descendants,
+         * including the object and field nodes themselves and any storage their strings and vectors have allocated.
+         * The buffer retained by a lazily read document is counted once.  Allocator overhead is not included.
+         */
+        size_t memoryUsage();
+
+        /**
+         * Frees the text kept by WriteStreamCached for this object and all of its descendants.
+         * The next cached write serializes the whole subtree again.  The text kept by its ancestors is rebuilt too.
+         */
+        void dropWriteCache();
+
+        /**
+         * Returns a 64-bit hash of this object's type, name, fields and child objects, in order.
+         * The hash is cached, and only recomputed for the parts of the tree that have changed since,
+         * so it can be used as a content address or cache key for a subtree.
+         * Because it caches, it is not safe to call concurrently with itself or any mutator on the same tree.
+         */
+        uint64_t getHash();
+
+        /**
+         * Returns true if other has the same type, name, fields and child objects as this object, in the same order.
+         * Returns false straight away if the hashes differ, so comparing different trees is usually O(1).
+         */
+        bool equals(SoffitObject* other);
+
+        /**
+         * Returns a deep copy of this object, including all of its fields and child objects.
+         * The copy is a root object, and must be deleted at some point.
+         */
+        SoffitObject* clone();
+
+        /**
+         * Returns every object of the given type beneath this object, at any depth, in document order.
+         * The first recursive query on a document builds an index of all of its objects by type and name, parsing
+         * any lazily read bodies.  Later queries are answered from the index, which add, delete, detach, setName and
+         * setType keep up to date.  Diff patches, merges and ReadStreamInto discard it, to be rebuilt on the next query.
+         * Not safe to call concurrently with any other call on the same document.
+         */
+        SoffitObjectRange getDescendantsByType(std::string type);
+
+        /**
+         * Returns every object with the given type and name beneath this object, at any depth, in document order.
+         * See getDescendantsByType.
+         */
+        SoffitObjectRange findAll(std::string type, std::string name);
+
+        /**
+         * Returns false if this object was read lazily and its body has not been parsed yet.
+         */
+        bool isBodyParsed();
+
+        /**
+         * Internal use.
+         * Defers parsing of this object's fields and child objects until one of them is first accessed.
+         */
+        void setLazyBody(std::shared_ptr<const std::string> source, size_t begin, size_t end, int lineNumber);
     };
 
     class SoffitField {
@@ -288,6 +489,24 @@ namespace CPPSoffit {
         std::string value;
         SoffitObject* parent = nullptr;
 
+        //Cached result of the typed getters.  Invalidated by setValue().
+        //Integers and doubles share storage, so only the most recently parsed of the two is cached.
+        enum ParsedFlags : uint8_t {
+            INTEGER_PARSED = 1, INTEGER_VALID = 2,
+            DOUBLE_PARSED = 4, DOUBLE_VALID = 8,
+            BOOL_PARSED = 16, BOOL_VALID = 32, BOOL_VALUE = 64
+        };
+        union {
+            int64_t parsedInteger;
+            double parsedDouble = 0.0;
+        };
+        uint8_t parsedFlags = 0;
+
+        friend class SoffitObject;
+        friend class SoffitParseContext;
+        friend class SoffitTreeBuilder;
+        friend bool _readStreamInto(SoffitObject* root, std::istream& stream, SoffitParseContext& context, SoffitError& error);
+
     public:
         /**
          * Constructs a new SoffitField with the specified name and value.
@@ -316,6 +535,24 @@ namespace CPPSoffit {
          */
         void setValue(std::string v);
 
+        /**
+         * Converts the value of this field to the requested type and stores it in out.
+         * Supported types are int, int64_t, double, and bool.
+         * Booleans are read from "true", "false", "1", and "0".
+         * Returns false, leaving out untouched, if the value can not be converted.
+         * The converted value is cached until the value is changed.
+         */
+        template<typename T>
+        bool getValueAs(T& out);
+
+        /**
+         * Sets the value of this field from a number or boolean.
+         * Supported types are int, int64_t, double, and bool.
+         * Doubles are written in their shortest round-trip form.
+         */
+        template<typename T>
+        void setValueAs(T v);
+
         /**
          * Returns the nesting level of this field.
          * This is really only used internally to set indention on a write operation.
@@ -327,12 +564,70 @@ namespace CPPSoffit {
          */
         SoffitObject* getParent();
 
+        /**
+         * Releases spare capacity held by this field's name and value.
+         */
+        void shrinkToFit();
+
+        /**
+         * Returns the number of bytes used by this field, including any storage its name and value have allocated.
+         */
+        size_t memoryUsage();
+
         /**
          * Internal use.
          */
         void setParent(SoffitObject* p);
     };
 
+    template<> bool SoffitField::getValueAs<int64_t>(int64_t& out);
+    template<> bool SoffitField::getValueAs<int>(int& out);
+    template<> bool SoffitField::getValueAs<double>(double& out);
+    template<> bool SoffitField::getValueAs<bool>(bool& out);
+    template<> void SoffitField::setValueAs<int64_t>(int64_t v);
+    template<> void SoffitField::setValueAs<int>(int v);
+    template<> void SoffitField::setValueAs<double>(double v);
+    template<> void SoffitField::setValueAs<bool>(bool v);
+
+    template<typename T>
+    T SoffitObject::getFieldAs(std::string fieldName, T defaultValue) {
+        SoffitField* field = getField(fieldName);
+        if (field == nullptr)
+            return defaultValue;
+
+        T result;
+        if (!field->getValueAs<T>(result))
+            return defaultValue;
+
+        return result;
+    }
+
+    /**
+     * The reasons a SOFFIT stream can fail to parse.
+     */
+    enum class SoffitErrorCode {
+        None,
+        HeaderNotFound,
+        IncompleteStream,
+        SyntaxError,
+        TooManyClosingBrackets,
+        FooterInObject,
+        InvalidEscapeSequence,
+        SchemaViolation,
+        ObjectNotFound,
+        LimitExceeded,
+        FileNotReadable
+    };
+
+    /**
+     * Describes why a parse failed.  lineNumber is 0 when the error is not tied to a line.
+     */
+    struct SoffitError {
+        SoffitErrorCode code = SoffitErrorCode::None;
+        std::string message;
+        int lineNumber = 0;
+    };
+
     class SoffitException : public std::exception {
     private:
         std::string message;
@@ -342,54 +637,1472 @@ namespace CPPSoffit {
         SoffitException(const std::string& message);
         SoffitException(const std::string& message, int soffitLineNumber);
         SoffitException(const SoffitException& se, int soffitLineNumber);
+        SoffitException(const SoffitError& error);
         const char* what() const noexcept override;
     };
 
-    //**************************************
-    //********** BEGIN UTILITIES************
-    //**************************************
+    /**
+     * The outcome of a non-throwing parse: either an owned document, or the error that stopped the parse.
+     * The document is deleted with the result unless it is released first.
+     */
+    class SoffitParseResult {
+    private:
+        SoffitObject* document;
+        SoffitError error;
+
+    public:
+        SoffitParseResult(SoffitObject* document);
+        SoffitParseResult(SoffitError&& error);
+        SoffitParseResult(SoffitParseResult&& other) noexcept;
+        SoffitParseResult& operator=(SoffitParseResult&& other) noexcept;
+        SoffitParseResult(const SoffitParseResult&) = delete;
+        SoffitParseResult& operator=(const SoffitParseResult&) = delete;
+        ~SoffitParseResult();
+
+        /**
+         * Returns true if the parse succeeded.
+         */
+        bool ok() const;
+
+        /**
+         * Returns the parsed document, still owned by this result, or nullptr if the parse failed.
+         */
+        SoffitObject* get() const;
+
+        /**
+         * Returns the parsed document and gives up ownership of it, or nullptr if the parse failed.
+         * Delete the returned root object at some point.
+         */
+        SoffitObject* release();
+
+        /**
+         * Returns the error, whose code is SoffitErrorCode::None if the parse succeeded.
+         */
+        const SoffitError& getError() const;
+    };
 
     /**
-     * Parses an input stream and returns a root SoffitObject pointer containing the parsed data.
-     * May throw a SoffitException for multiple reasons during input and parsing.
-     * Delete the returned root object at some point.
-     * If the root object is deleted, the destructor will also delete all child objects and fields.
+     * Counters collected while reading, searching or writing a SOFFIT stream.
+     * Pass one to ReadStream, FindInStream or WriteStream to have it filled in for that call,
+     * or enable the SoffitStatsRegistry to collect process-wide totals.
+     * Collection costs a single branch per line when it is not requested,
+     * and can be compiled out entirely by defining CPPSOFFIT_NO_STATS.
      */
-    SoffitObject* ReadStream(std::istream& stream);
+    struct SoffitStats {
+        uint64_t bytesRead = 0;
+        uint64_t linesRead = 0;
+        uint64_t commentLinesSkipped = 0;
+        uint64_t blankLinesSkipped = 0;
+        uint64_t objectsCreated = 0;
+        uint64_t fieldsCreated = 0;
+        uint64_t maxDepth = 0;
+        uint64_t escapeSequencesDecoded = 0;
+
+        uint64_t bytesWritten = 0;
+        uint64_t objectsWritten = 0;
+        uint64_t fieldsWritten = 0;
+        uint64_t escapeSequencesEncoded = 0;
+
+        //Time spent reading lines from the stream, splitting them into tokens,
+        //decoding escape sequences, creating objects and fields, and writing output
+        double ioSeconds = 0.0;
+        double tokenizeSeconds = 0.0;
+        double unescapeSeconds = 0.0;
+        double buildSeconds = 0.0;
+        double writeSeconds = 0.0;
+
+        /**
+         * Returns the number of objects and fields created by the parser, objectsCreated plus fieldsCreated.
+         * The heap allocations made for their strings and vectors are not counted.
+         */
+        uint64_t getNodesCreated() const;
+
+        /**
+         * Adds another set of counters to this one.  maxDepth keeps the larger of the two.
+         */
+        void add(const SoffitStats& other);
+    };
 
     /**
-     * Writes a root SoffitObject to an output stream.
-     * Contains an optional flag to indent objects and fields based off of their nesting level.
-     * Indentation may be turned off in situations where the stream is not made to be primarily human readable.
-     * This will save a small amount of bandwidth/memory and time during writing, and conversly, re-parsing the data.
+     * Process-wide totals of SoffitStats, kept per operation ("read", "find" and "write").
+     * Disabled by default.  While enabled, every ReadStream, FindInStream and WriteStream call is counted,
+     * whether or not the caller asked for its own SoffitStats.
      */
-    void WriteStream(SoffitObject* root, std::ostream& output, bool indent = true);
+    class SoffitStatsRegistry {
+    public:
+        /**
+         * Turns process-wide collection on or off.
+         */
+        static void setEnabled(bool enabled);
+
+        /**
+         * Returns true if process-wide collection is on.
+         */
+        static bool isEnabled();
+
+        /**
+         * Adds the counters from a single call to the totals of an operation.
+         */
+        static void record(const std::string& operation, const SoffitStats& stats);
+
+        /**
+         * Returns the totals of an operation.
+         */
+        static SoffitStats getTotals(const std::string& operation);
+
+        /**
+         * Clears all totals.
+         */
+        static void reset();
+
+        /**
+         * Returns all totals in the Prometheus text exposition format.
+         */
+        static std::string toPrometheus();
+    };
+
+#ifdef CPPSOFFIT_NO_STATS
+#define SOFFIT_STATS_ON(stats) false
+#else
+#define SOFFIT_STATS_ON(stats) ((stats) != nullptr)
+#endif
 
     /**
-     * Parses a string and returns a root SoffitObject pointer containing the parsed data.
-     * May throw a SoffitException for multiple reasons during input and parsing.
-     * Delete the returned root object at some point.
-     * If the root object is deleted, the destructor will also delete all child objects and fields.
+     * A compiled SOFFIT schema, used to validate documents while they are being parsed.
+     * The schema is itself written in SOFFIT:
+     *
+     *     Root {
+     *         Field "MaintenanceTracker" {
+     *             Min "1"
+     *         }
+     *         Child "Vehicle" {
+     *         }
+     *     }
+     *     Type "Service" {
+     *         Strict
+     *         Field "Date" {
+     *             Min "1"
+     *             Max "1"
+     *             Pattern "[0-9]+ [A-Za-z]+ [0-9]+"
+     *         }
+     *     }
+     *
+     * Root holds the rules for the root object, and each Type holds the rules for every object of that type.
+     * Field rules apply to fields by name, and Child rules apply to child objects by type.
+     * Min and Max limit how many times a field or child may appear, and Pattern is a regular expression
+     * the field value or child object name must fully match.
+     * Strict rejects any field or child that does not have a rule.  Objects of types without a Type entry are not checked.
+     * Compile a schema once, and reuse it for every document.
      */
-    SoffitObject* ReadStreamFromString(std::string& stream);
+    class SoffitSchema {
+    private:
+        struct Rule {
+            std::string description;
+            int min = 0;
+            int max = -1;
+            bool hasPattern = false;
+            std::regex pattern;
+        };
+
+        struct Type {
+            bool strict = false;
+            std::vector<Rule> rules;
+            std::unordered_map<std::string, int> fieldRules;
+            std::unordered_map<std::string, int> objectRules;
+        };
+
+        //Index 0 is the root object
+        std::vector<Type> types;
+        std::unordered_map<std::string, int> typeIndices;
+
+        void compileType(SoffitObject* definition, Type& type);
+        Rule compileRule(SoffitObject* definition);
+
+        friend class SoffitValidator;
+
+    public:
+        /**
+         * Compiles a schema from a parsed SOFFIT schema document.
+         * The schema document is not retained and may be deleted afterwards.
+         * Throws a SoffitException if the schema is malformed.
+         */
+        SoffitSchema(SoffitObject* schemaRoot);
+    };
 
     /**
-     * Writes a root SoffitObject to a string.
-     * Contains an optional flag to indent objects and fields based off of their nesting level.
-     * Indentation may be turned off in situations where the stream is not made to be primarily human readable.
-     * This will save a small amount of bandwidth/memory and time during writing, and conversly, re-parsing the data.
+     * Selects the parts of a document that ReadStream builds, for consumers that only need some of it.
+     * Objects are kept by type, and fields of kept objects are kept by name.  An object that is not kept is still
+     * read for kept objects inside it; if there are any it is built as an empty parent, with its type and name but no
+     * fields, so that they keep their place in the tree.  Otherwise nothing in it is built.
+     * With no types kept every object is kept, and with no field names kept every field is kept.
+     * A predicate may be given as well as, or instead of, a set; a node is kept only if it passes both.
+     * The root object is always kept.  For example, to read only Service objects and their Date fields:
+     *
+     *     SoffitProjection projection;
+     *     projection.keepType("Service");
+     *     projection.keepField("Date");
+     *     SoffitObject* root = ReadStream(stream, projection);
+     *
+     * In the example in 'SOFFIT Definition.txt' this gives the Vehicle object, without its fields, holding the two
+     * Service objects and their Date fields.
      */
-    std::string WriteStreamToString(SoffitObject* root, bool indent = true);
+    class SoffitProjection {
+    private:
+        std::unordered_set<std::string> types;
+        std::unordered_set<std::string> fieldNames;
+        std::function<bool(const std::string&, const std::string&)> objectPredicate;
+        std::function<bool(const std::string&)> fieldPredicate;
 
-    //internal implementation
-    void _writeObjects(SoffitObject* object, std::ostream& output, bool indent);
-    void _parseObject(std::istream& stream, SoffitObject* parent, int lineNumber);
-    std::vector<std::string> _getLineTokens(std::string& line, int lineNumber);
-    std::string _getLine(std::istream& stream, int& lineNumber);
-    bool _isObject(std::vector<std::string>& tokens);
-    bool _isField(std::vector<std::string>& tokens);
-    std::string _convertFromEscapeSequence(const std::string& s, int lineNumber);
-    std::string _convertToEscapeSequence(const std::string& s);
+    public:
+        /**
+         * Keeps objects of the given type.
+         */
+        void keepType(std::string type);
+
+        /**
+         * Keeps fields with the given name.
+         */
+        void keepField(std::string name);
+
+        /**
+         * Keeps only objects for which the predicate, given the type and name of the object, returns true.
+         */
+        void keepObjectsWhere(std::function<bool(const std::string& type, const std::string& name)> predicate);
+
+        /**
+         * Keeps only fields for which the predicate, given the name of the field, returns true.
+         */
+        void keepFieldsWhere(std::function<bool(const std::string& name)> predicate);
+
+        /**
+         * Returns whether objects of the given type can be kept, before their name is known.
+         */
+        bool keepsType(const std::string& type) const;
+
+        /**
+         * Returns whether an object with the given type and name is kept.
+         */
+        bool keepsObject(const std::string& type, const std::string& name) const;
+
+        /**
+         * Returns whether a field with the given name is kept.
+         */
+        bool keepsField(const std::string& name) const;
+    };
+
+    /**
+     * Bounds on the resources a single ReadStream call may use, for reading documents from untrusted sources.
+     * Each limit is checked as the stream is read, before the line, object or field that would break it is stored,
+     * and the parse fails with SoffitErrorCode::LimitExceeded as soon as one is broken.
+     * A limit of 0 is no limit.  For example, to accept at most 1 MB in 10000 nodes, nested no deeper than 16:
+     *
+     *     SoffitLimits limits;
+     *     limits.maxBytes = 1 << 20;
+     *     limits.maxNodes = 10000;
+     *     limits.maxDepth = 16;
+     *     SoffitObject* root = ReadStream(stream, limits);
+     */
+    struct SoffitLimits {
+        //Characters in a single line, including indentation
+        uint64_t maxLineLength = 0;
+        //Objects nested inside one another, with the root's children at depth 1
+        uint64_t maxDepth = 0;
+        //Objects and fields in the document, not counting the root
+        uint64_t maxNodes = 0;
+        //Bytes read from the stream, including blank lines, comments and line terminators
+        uint64_t maxBytes = 0;
+        //Characters in a decoded field value or object name
+        uint64_t maxValueSize = 0;
+    };
+
+    /**
+     * Internal use.
+     * Tracks the state of a single validation pass against a SoffitSchema.
+     * Each check returns false, filling in error with the offending line number, as soon as a rule is broken.
+     */
+    class SoffitValidator {
+    private:
+        struct Frame {
+            int type;
+            std::vector<int> counts;
+        };
+
+        const SoffitSchema* schema;
+        std::vector<Frame> frames;
+        int depth = 0;
+
+        bool countRule(Frame& frame, int rule, const std::string& value, int lineNumber, SoffitError& error);
+        void pushFrame(int type);
+
+    public:
+        SoffitValidator(const SoffitSchema* schema);
+        bool enterObject(const std::string& type, const std::string& name, int lineNumber, SoffitError& error);
+        bool field(const std::string& name, const std::string& value, int lineNumber, SoffitError& error);
+        bool exitObject(int lineNumber, SoffitError& error);
+    };
+
+    /**
+     * Receives the contents of a SOFFIT stream as a sequence of events, in document order.
+     * Override only the events that are needed; the default implementations do nothing.
+     * Names and values have already had their escape sequences decoded.
+     */
+    class SoffitEventHandler {
+    private:
+        std::string chunkedName;
+        std::string chunkedValue;
+
+    public:
+        virtual ~SoffitEventHandler() {}
+
+        /**
+         * Called when an object is opened.  name is empty for anonymous objects.
+         */
+        virtual void startObject(const std::string& /*type*/, const std::string& /*name*/, int /*lineNumber*/) {}
+
+        /**
+         * Called when the most recently opened object is closed.
+         */
+        virtual void endObject(int /*lineNumber*/) {}
+
+        /**
+         * Called for each field.  value is empty for null fields.
+         */
+        virtual void field(const std::string& /*name*/, const std::string& /*value*/, int /*lineNumber*/) {}
+
+        /**
+         * Called instead of field for a value that is streamed in chunks, before the first chunk.
+         * The default implementations of startField, fieldChunk and endField gather the value and pass it to field,
+         * so handlers that do not override them still see every field, at the cost of holding the value in memory.
+         * Override all three together.
+         */
+        virtual void startField(const std::string& name, int lineNumber);
+
+        /**
+         * Called with each decoded piece of a streamed value, in order.  data is only valid during the call.
+         */
+        virtual void fieldChunk(const char* data, size_t length);
+
+        /**
+         * Called once every chunk of a streamed value has been passed to fieldChunk.
+         */
+        virtual void endField(int lineNumber);
+
+        /**
+         * Called when the footer is reached.
+         */
+        virtual void endDocument(int /*lineNumber*/) {}
+    };
+
+    /**
+     * A SoffitEventHandler that builds a SoffitObject tree from the events it receives.
+     */
+    class SoffitTreeBuilder : public SoffitEventHandler {
+    private:
+        SoffitObject* root;
+        SoffitObject* current;
+        SoffitField* chunked = nullptr;
+
+    public:
+        SoffitTreeBuilder();
+
+        /**
+         * Deletes the tree if it has not been taken.
+         */
+        ~SoffitTreeBuilder();
+
+        void startObject(const std::string& type, const std::string& name, int lineNumber) override;
+        void endObject(int lineNumber) override;
+        void field(const std::string& name, const std::string& value, int lineNumber) override;
+
+        /**
+         * Streamed values are appended directly to the new field, rather than gathered and copied.
+         */
+        void startField(const std::string& name, int lineNumber) override;
+        void fieldChunk(const char* data, size_t length) override;
+        void endField(int lineNumber) override;
+
+        /**
+         * Returns the root of the built tree and gives up ownership of it.
+         * A new, empty root is started for any further events.
+         */
+        SoffitObject* takeRoot();
+    };
+
+    /**
+     * A SoffitEventHandler that writes the events it receives to an output stream as JSON, without building a tree.
+     * Each document becomes a JSON object, followed by a new line.  Memory use depends only on the nesting depth
+     * and the longest value, so streams of any length can be converted.
+     *
+     * Every object becomes an element of an array keyed by its type, and a named object holds its name as its first
+     * member, keyed by SOFFIT_JSON_NAME.  A field becomes a string member, or null when its value is empty.
+     * Consecutive fields of the same name, and consecutive objects of the same type, share one key and one array.
+     * A name that repeats after something else has come between is written as a duplicate key, so that document order
+     * is kept; JSON readers that keep only the last duplicate will lose data.  Gathering every repeat into one array
+     * would need the whole object in memory, and would lose the order between different names, which JsonToSoffit
+     * needs to give back the same document.
+     * Values are written byte for byte, so they should be UTF-8 to give valid JSON.
+     * A streamed value is written as it arrives.  As it can not be held back, a streamed value that does not follow a
+     * field of the same name is written alone, and a field of that name after it starts a new key.
+     * Throws a SoffitException for a field or object type named SOFFIT_JSON_NAME.
+     */
+    class SoffitJsonWriter : public SoffitEventHandler {
+    private:
+        enum Run { None, Fields, Objects };
+
+        //The open run of members within one JSON object.  Levels are never removed, so their buffers are reused
+        struct Level {
+            Run run = None;
+            std::string key;
+            std::string pending;
+            bool hasPending = false;
+            bool array = false;
+            bool first = true;
+        };
+
+        std::ostream* output;
+        bool indent;
+        bool started = false;
+        std::vector<Level> levels;
+        size_t depth = 0;
+
+        void begin();
+        void newLine(size_t indentation);
+        void writeKey(Level& level, const std::string& key);
+        void writeValue(const std::string& value);
+        void writeElement(Level& level);
+        void closeRun();
+
+    public:
+        SoffitJsonWriter(std::ostream& output, bool indent = true);
+
+        void startObject(const std::string& type, const std::string& name, int lineNumber) override;
+        void endObject(int lineNumber) override;
+        void field(const std::string& name, const std::string& value, int lineNumber) override;
+        void startField(const std::string& name, int lineNumber) override;
+        void fieldChunk(const char* data, size_t length) override;
+        void endField(int lineNumber) override;
+        void endDocument(int lineNumber) override;
+    };
+
+    /**
+     * A SoffitEventHandler that writes the events it receives to an output stream as SOFFIT, so documents can be
+     * written or rewritten without building a tree.  The header is written with the first event of each document,
+     * and the footer by endDocument.  Indentation follows WriteStream.
+     * Streamed values are escaped and written as their chunks arrive, so they are never held in memory.
+     */
+    class SoffitStreamWriter : public SoffitEventHandler {
+    private:
+        std::ostream* output;
+        bool indent;
+        bool started = false;
+        int depth = 0;
+
+        void begin();
+        void writeIndent(int nestingLevel);
+
+    public:
+        SoffitStreamWriter(std::ostream& output, bool indent = true);
+
+        void startObject(const std::string& type, const std::string& name, int lineNumber = 0) override;
+        void endObject(int lineNumber = 0) override;
+        void field(const std::string& name, const std::string& value, int lineNumber = 0) override;
+        void startField(const std::string& name, int lineNumber = 0) override;
+        void fieldChunk(const char* data, size_t length) override;
+        void endField(int lineNumber = 0) override;
+        void endDocument(int lineNumber = 0) override;
+
+        /**
+         * Writes a field whose value is read from source in chunks, until the end of source.
+         */
+        void field(const std::string& name, std::istream& source);
+    };
+
+    /**
+     * A resumable parser for input that arrives in fragments, such as from a non-blocking socket.
+     * Feed fragments as they arrive; complete lines are parsed immediately, and the unfinished tail of the
+     * last line (including any partial escape sequence) is kept until the rest of it arrives.
+     * feed never blocks, so it can be called directly from an event loop or coroutine.
+     * Syntax errors throw a SoffitException from the feed call that completes the offending line.
+     *
+     * A field or object line longer than the chunk threshold is not held whole: its string is decoded as it arrives,
+     * and passed on once the end of the line shows which of the two it is.  A field's value goes to the handler's
+     * startField, fieldChunk and endField events, and an object to startObject.  Memory then holds the decoded string
+     * once, rather than the raw line and copies of it.  This is off by default when building a tree.
+     */
+    class SoffitPushParser {
+    private:
+        SoffitEventHandler* handler;
+        SoffitTreeBuilder* builder = nullptr;
+        std::string pending;
+        std::string line;
+        std::vector<std::string> tokens;
+        std::string value;
+        int lineNumber = 0;
+        int depth = 0;
+        bool headerFound = false;
+        bool complete = false;
+
+        //State of a long line whose string is decoded as it arrives
+        size_t chunkThreshold = 1024 * 1024;
+        bool streaming = false;
+        bool escaped = false;
+        bool closed = false;
+        bool separated = false;
+        bool opened = false;
+        bool unchunked = false;
+
+        void parseLine(const char* begin, const char* end);
+        bool startChunkedField();
+        const char* feedChunked(const char* p, const char* end);
+        void finishChunked();
+
+    public:
+        /**
+         * Constructs a push parser that builds a SoffitObject tree, returned by finish.
+         */
+        SoffitPushParser();
+
+        /**
+         * Constructs a push parser that sends events to a handler instead of building a tree.
+         * The handler is not owned, and must outlive the parser.
+         */
+        SoffitPushParser(SoffitEventHandler* handler);
+        ~SoffitPushParser();
+
+        /**
+         * Parses the next fragment of the stream.
+         * Returns the number of bytes consumed, which is less than length only when the footer has been reached.
+         * Bytes after the footer are left for the caller, as they may belong to another stream.
+         */
+        size_t feed(const char* data, size_t length);
+
+        /**
+         * Signals the end of input, and parses any final line that had no line terminator.
+         * Throws a SoffitException if the footer has not been reached.
+         * Returns the root object when building a tree, which must be deleted at some point, or nullptr when using a handler.
+         */
+        SoffitObject* finish();
+
+        /**
+         * Returns true once the footer has been parsed.
+         */
+        bool isComplete();
+
+        /**
+         * Returns the number of lines processed so far.
+         */
+        int getLineNumber();
+
+        /**
+         * Returns true once anything other than blank lines and comments has been fed.
+         */
+        bool hasStarted();
+
+        /**
+         * Sets the length in bytes above which a field or object line is decoded as it arrives instead of held whole.
+         * 0 turns this off.  The default is 1 MiB with a handler, and 0 when building a tree, which holds every value
+         * whole anyway.
+         */
+        void setChunkThreshold(size_t bytes);
+
+        /**
+         * Prepares the parser for another stream, keeping its buffers.
+         * Any tree that has not been returned by finish is deleted.
+         */
+        void reset();
+    };
+
+    /**
+     * Reads consecutive SOFFIT streams, each framed by its own header and footer, from one long-lived input,
+     * such as a pipe or a log of messages.
+     * Only the bytes already available are read ahead, so a document is returned as soon as its footer arrives.
+     * The read buffer and parser state are reused from one document to the next.
+     */
+    class SoffitDocumentReader {
+    private:
+        std::istream& stream;
+        std::vector<char> buffer;
+        size_t bufferBegin = 0;
+        size_t bufferEnd = 0;
+        SoffitPushParser parser;
+        uint64_t documentCount = 0;
+
+        //Lines left to drop of a document that failed to parse, before looking for the next header
+        int skipLines = 0;
+
+        bool fillBuffer();
+        bool skipDocument();
+
+    public:
+        /**
+         * Constructs a reader over a stream.  The stream must outlive the reader.
+         * @param stream
+         * @param bufferSize The size of the read buffer.
+         */
+        SoffitDocumentReader(std::istream& stream, size_t bufferSize = 64 * 1024);
+
+        /**
+         * Reads the next document and returns its root object, which must be deleted at some point.
+         * Returns nullptr when the input ends cleanly between documents.
+         * Throws a SoffitException if a document is malformed or the input ends inside one.  The next call skips the
+         * rest of the malformed document and resumes at the following header line, so one bad document does not stop
+         * the reader.
+         */
+        SoffitObject* next();
+
+        /**
+         * Reads up to count documents, appending their root objects to documents.
+         * Returns the number of documents read, which is less than count only at the end of the input.
+         */
+        size_t nextBatch(std::vector<SoffitObject*>& documents, size_t count);
+
+        /**
+         * Returns the number of documents read so far.
+         */
+        uint64_t getDocumentCount();
+    };
+
+    /**
+     * The changes a SoffitReloader::reload made to the top level of its tree.
+     * An edited object shows up twice: its old version in removed, and its new version in added.
+     * The removed objects have been detached from the tree, and are deleted with the changes.
+     */
+    class SoffitReloadChanges {
+    private:
+        std::vector<SoffitObject*> added;
+        std::vector<SoffitObject*> removed;
+        bool fieldsChanged = false;
+        bool reordered = false;
+
+        friend class SoffitReloader;
+
+    public:
+        SoffitReloadChanges();
+        SoffitReloadChanges(SoffitReloadChanges&& other) noexcept;
+        SoffitReloadChanges& operator=(SoffitReloadChanges&& other) noexcept;
+        SoffitReloadChanges(const SoffitReloadChanges&) = delete;
+        SoffitReloadChanges& operator=(const SoffitReloadChanges&) = delete;
+        ~SoffitReloadChanges();
+
+        /**
+         * Returns the top level objects that were parsed by the reload, in document order.  They are owned by the tree.
+         */
+        const std::vector<SoffitObject*>& getAdded() const;
+
+        /**
+         * Returns the top level objects that are no longer in the document.  They are owned by these changes.
+         */
+        const std::vector<SoffitObject*>& getRemoved() const;
+
+        /**
+         * Returns true if the root's own fields were replaced.
+         */
+        bool haveFieldsChanged() const;
+
+        /**
+         * Returns true if top level objects that were kept have changed places.
+         */
+        bool isReordered() const;
+
+        /**
+         * Returns true if the reload changed the tree at all.
+         */
+        bool hasChanges() const;
+    };
+
+    /**
+     * Keeps a document up to date with a stream that changes over time, such as a configuration file.
+     * The region of each top level object is fingerprinted, ignoring indentation, blank lines and comments, and a reload
+     * only parses the regions whose fingerprints are new.  These are spliced into the existing tree, while objects whose
+     * regions are unchanged keep their addresses, along with everything beneath them.  The root's own fields are
+     * fingerprinted together, and replaced as a group when any of them change.
+     * The tree may be changed between reloads.  A top level object that has been changed is noticed by its hash, and
+     * replaced with a fresh copy from the stream, so the tree always matches the stream after a reload.
+     */
+    class SoffitReloader {
+    private:
+        struct Region {
+            SoffitObject* object;
+            uint64_t fingerprint;
+            uint64_t hash;
+        };
+
+        SoffitObject* root;
+        std::vector<Region> regions;
+        uint64_t fieldsFingerprint = 0;
+        uint64_t fieldsHash;
+
+    public:
+        /**
+         * Constructs a reloader with an empty tree.  The first reload parses the whole stream.
+         */
+        SoffitReloader();
+
+        /**
+         * Deletes the tree.
+         */
+        ~SoffitReloader();
+        SoffitReloader(const SoffitReloader&) = delete;
+        SoffitReloader& operator=(const SoffitReloader&) = delete;
+
+        /**
+         * Reads a new version of the stream and brings the tree up to date with it, returning what changed.
+         * Throws a SoffitException if the stream is malformed, leaving the tree as it was.
+         */
+        SoffitReloadChanges reload(std::istream& stream);
+
+        /**
+         * Reloads from a string.  See reload.
+         */
+        SoffitReloadChanges reloadFromString(std::string& stream);
+
+        /**
+         * Returns the root of the tree, which is owned by the reloader.
+         */
+        SoffitObject* getRoot();
+    };
+
+    /**
+     * Internal use.
+     * Indexes every object beneath a root by type, and by type and name, for the recursive queries on SoffitObject.
+     * Every list is kept in document order, and every object in an indexed document carries a sparse order key,
+     * so the objects beneath any one object form a run that is found by binary search.
+     */
+    class SoffitIndex {
+    private:
+        struct Bucket {
+            std::vector<SoffitObject*> objects;
+            std::unordered_map<std::string, std::vector<SoffitObject*>> byName;
+        };
+
+        SoffitObject* root;
+        std::unordered_map<std::string, Bucket> types;
+
+        static bool before(const SoffitObject* object, uint64_t order);
+        static bool after(uint64_t order, const SoffitObject* object);
+        static SoffitObject* lastDescendant(SoffitObject* object);
+        static SoffitObjectRange range(const std::vector<SoffitObject*>& objects, SoffitObject* within);
+        static void eraseRange(std::vector<SoffitObject*>& objects, uint64_t low, uint64_t high);
+
+        void collect(SoffitObject* object, std::vector<SoffitObject*>& nodes);
+        void renumber();
+        void removeRange(SoffitObject* object, uint64_t low, uint64_t high, bool recursive);
+
+    public:
+        /**
+         * Indexes the document under root, parsing any lazily read bodies.
+         */
+        SoffitIndex(SoffitObject* root);
+
+        /**
+         * Returns the index of the document that object belongs to, building it first if there is none.
+         */
+        static SoffitIndex* of(SoffitObject* object);
+
+        SoffitObjectRange find(SoffitObject* within, const std::string& type);
+        SoffitObjectRange find(SoffitObject* within, const std::string& type, const std::string& name);
+
+        /**
+         * Indexes an object, and everything beneath it, that has just been added as the last child of its parent.
+         */
+        void insertSubtree(SoffitObject* object);
+
+        /**
+         * Removes an object, and everything beneath it, that is about to be deleted or detached.
+         */
+        void removeSubtree(SoffitObject* object);
+
+        /**
+         * Adds or removes a single object, around a change to its type or name.
+         */
+        void addNode(SoffitObject* object);
+        void removeNode(SoffitObject* object);
+
+        size_t memoryUsage();
+    };
+
+    /**
+     * Internal use.
+     * A unit of work for a SoffitThreadPool: run is called with the task itself, on one of the pool's threads.
+     */
+    struct SoffitThreadPoolTask {
+        void (*run)(SoffitThreadPool& pool, const SoffitThreadPoolTask& task);
+        void* job;
+        void* data;
+        size_t begin;
+        size_t end;
+    };
+
+    /**
+     * A fixed set of worker threads that balance work by stealing it from each other.
+     * Each worker runs the newest task from its own queue first, and a worker with nothing to do takes the oldest
+     * task from another worker's queue, which for tree traversals is the largest piece of work left.
+     * One pool can serve any number of calls, but callbacks must not start another call on the pool they run on.
+     */
+    class SoffitThreadPool {
+    private:
+        struct Worker {
+            std::mutex mutex;
+            std::deque<SoffitThreadPoolTask> tasks;
+        };
+
+        std::vector<Worker*> workers;
+        std::vector<std::thread> threads;
+        std::atomic<size_t> queued{ 0 };
+        std::atomic<size_t> sleeping{ 0 };
+        std::atomic<size_t> nextWorker{ 0 };
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+        bool stopping = false;
+
+        void run(size_t index);
+        bool take(size_t index, SoffitThreadPoolTask& task);
+
+    public:
+        /**
+         * Starts threadCount worker threads, or one per hardware thread if threadCount is 0.
+         */
+        SoffitThreadPool(size_t threadCount = 0);
+
+        /**
+         * Stops the worker threads after the tasks already queued have run.
+         */
+        ~SoffitThreadPool();
+
+        SoffitThreadPool(const SoffitThreadPool&) = delete;
+        SoffitThreadPool& operator=(const SoffitThreadPool&) = delete;
+
+        /**
+         * Returns the number of worker threads.
+         */
+        size_t getThreadCount();
+
+        /**
+         * Internal use.
+         * Queues a task.  Tasks queued from a worker go to that worker's own queue.
+         */
+        void push(const SoffitThreadPoolTask& task);
+
+        /**
+         * Returns the index of the calling worker thread within its pool, or -1 if it is not a worker thread.
+         */
+        static int currentWorker();
+
+        /**
+         * Returns a pool with one thread per hardware thread, created on first use and shared by the whole process.
+         */
+        static SoffitThreadPool& shared();
+    };
+
+    /**
+     * Keeps the nodes and buffers that ReadStreamInto recycles from one parse to the next.
+     * Nodes left over when a document is smaller than the last one are kept here until a later document needs them.
+     * Use one context per thread; a context is not safe to share between threads.
+     */
+    class SoffitParseContext {
+    private:
+        struct Frame {
+            SoffitObject* object;
+            size_t fieldCount;
+            size_t objectCount;
+        };
+
+        std::vector<SoffitObject*> freeObjects;
+        std::vector<SoffitField*> freeFields;
+        std::vector<Frame> frames;
+        std::string line;
+        std::vector<std::string> tokens;
+
+        SoffitObject* nextObject(SoffitObject* parent, size_t index);
+        SoffitField* nextField(SoffitObject* parent, size_t index);
+        void trim(Frame& frame);
+        void recycle(SoffitObject* object);
+
+        friend bool _readStreamInto(SoffitObject* root, std::istream& stream, SoffitParseContext& context, SoffitError& error);
+
+    public:
+        SoffitParseContext();
+
+        /**
+         * Deletes the nodes held for reuse.
+         */
+        ~SoffitParseContext();
+
+        /**
+         * Returns the number of objects and fields currently held for reuse.
+         */
+        size_t getPooledNodeCount();
+
+        /**
+         * Deletes the nodes held for reuse, such as after an unusually large document.
+         */
+        void clear();
+    };
+
+    /**
+     * A field read in place from a SoffitImage.  Its name and value point into the image, and stay valid while the
+     * image is open.
+     */
+    class SoffitImageField {
+    private:
+        const SoffitImage* image;
+        uint64_t index;
+
+    public:
+        /**
+         * Internal use.
+         */
+        SoffitImageField(const SoffitImage* image = nullptr, uint64_t index = 0);
+
+        std::string_view getName() const;
+        std::string_view getValue() const;
+    };
+
+    /**
+     * An object read in place from a SoffitImage, without building a SoffitObject.  Views are small values that
+     * can be copied freely; their strings point into the image, and stay valid while the image is open.
+     * Children and fields keep their document order, and lookups by type and name, or by field name, use indexes
+     * stored in the image, so they take logarithmic time and allocate nothing.
+     */
+    class SoffitImageObject {
+    private:
+        const SoffitImage* image;
+        uint64_t index;
+
+    public:
+        /**
+         * Internal use.
+         */
+        SoffitImageObject(const SoffitImage* image = nullptr, uint64_t index = 0);
+
+        std::string_view getType() const;
+        std::string_view getName() const;
+
+        /**
+         * Returns true for the root object of the image, which has no parent.
+         */
+        bool isRoot() const;
+
+        /**
+         * Returns the parent of this object.  Must not be called on the root object.
+         */
+        SoffitImageObject getParent() const;
+
+        size_t getObjectCount() const;
+        size_t getFieldCount() const;
+
+        /**
+         * Returns the child object or field at position i, in document order.
+         */
+        SoffitImageObject getObjectAt(size_t i) const;
+        SoffitImageField getFieldAt(size_t i) const;
+
+        /**
+         * Finds the first child object with the given type and name, storing it in out.
+         * Returns false, leaving out untouched, if there is none.
+         */
+        bool getObjectByTypeAndName(std::string_view type, std::string_view name, SoffitImageObject& out) const;
+
+        /**
+         * Finds the first field with the given name, storing it in out.
+         * Returns false, leaving out untouched, if there is none.
+         */
+        bool getField(std::string_view name, SoffitImageField& out) const;
+
+        /**
+         * Copies this object and everything beneath it into a new SoffitObject tree, which can then be edited.
+         * Delete the returned object at some point.
+         */
+        SoffitObject* toObject() const;
+    };
+
+    /**
+     * A document saved by SaveImage and opened by LoadImage.  The image is mapped read-only and used as it is,
+     * so opening one takes the same time whatever its size, and its pages are shared by every process that has
+     * it open.  Loading checks the header, version and section bounds, and each access checks the offsets it
+     * follows, so a damaged image throws a SoffitException rather than reading out of bounds.  The checksum
+     * covers the whole image, so it is only checked on request.
+     */
+    class SoffitImage {
+    private:
+        struct Header;
+        struct Object;
+        struct Field;
+        struct String;
+
+        const char* data = nullptr;
+        size_t size = 0;
+        const Header* header = nullptr;
+        const Object* objects = nullptr;
+        const Field* fields = nullptr;
+        const uint64_t* objectIndex = nullptr;
+        const uint64_t* fieldIndex = nullptr;
+        const char* strings = nullptr;
+
+        //The mapping behind data, if this image owns one
+        void* mapping = nullptr;
+        size_t mappingSize = 0;
+
+        SoffitImage(const char* data, size_t size);
+        const Object& object(uint64_t index) const;
+        const Field& field(uint64_t index) const;
+        std::string_view string(const String& s) const;
+
+        friend class SoffitImageObject;
+        friend class SoffitImageField;
+        friend SoffitImage* LoadImage(const std::string& path, bool verifyChecksum);
+        friend SoffitImage* LoadImageFromMemory(const char* data, size_t size, bool verifyChecksum);
+        friend void SaveImage(SoffitObject* root, std::ostream& output);
+
+    public:
+        /**
+         * Unmaps the image.  Views taken from it must not be used afterwards.
+         */
+        ~SoffitImage();
+
+        SoffitImage(const SoffitImage&) = delete;
+        SoffitImage& operator=(const SoffitImage&) = delete;
+
+        /**
+         * Returns the root object of the document.
+         */
+        SoffitImageObject getRoot() const;
+
+        uint64_t getObjectCount() const;
+        uint64_t getFieldCount() const;
+
+        /**
+         * Recomputes the checksum over the whole image and returns true if it matches the header.
+         */
+        bool verify() const;
+    };
+
+    //**************************************
+    //********** BEGIN UTILITIES************
+    //**************************************
+
+    /**
+     * Parses an input stream and returns a root SoffitObject pointer containing the parsed data.
+     * May throw a SoffitException for multiple reasons during input and parsing.
+     * Delete the returned root object at some point.
+     * If the root object is deleted, the destructor will also delete all child objects and fields.
+     */
+    SoffitObject* ReadStream(std::istream& stream);
+
+    /**
+     * Parses an input stream, as ReadStream, and fills stats with counters describing the parse.
+     * Any previous contents of stats are overwritten.
+     */
+    SoffitObject* ReadStream(std::istream& stream, SoffitStats& stats);
+
+    /**
+     * Parses an input stream, validating it against a compiled schema as each line is read.
+     * Throws a SoffitException at the first line that breaks the schema, before the rest of the stream is parsed.
+     * Delete the returned root object at some point.
+     */
+    SoffitObject* ReadStream(std::istream& stream, const SoffitSchema& schema);
+
+    /**
+     * Parses an input stream, as ReadStream, but reports a malformed stream through the result instead of throwing.
+     * Nothing is leaked on failure.
+     */
+    SoffitParseResult TryReadStream(std::istream& stream);
+
+    /**
+     * Parses an input stream and validates it against a compiled schema, as ReadStream, without throwing.
+     */
+    SoffitParseResult TryReadStream(std::istream& stream, const SoffitSchema& schema);
+
+    /**
+     * Parses an input stream, building only the objects and fields selected by projection.
+     * Skipped subtrees are still checked for balanced brackets, but nothing inside them is built or decoded.
+     * Delete the returned root object at some point.
+     */
+    SoffitObject* ReadStream(std::istream& stream, const SoffitProjection& projection);
+
+    /**
+     * Parses an input stream, as ReadStream with a projection, without throwing.
+     */
+    SoffitParseResult TryReadStream(std::istream& stream, const SoffitProjection& projection);
+
+    /**
+     * Parses a string, as ReadStreamFromString, without throwing.
+     */
+    SoffitParseResult TryReadStreamFromString(std::string& stream);
+
+    /**
+     * Parses an input stream, failing with SoffitErrorCode::LimitExceeded as soon as it breaks one of limits.
+     * Throws a SoffitException if the stream is malformed or too large.
+     * Delete the returned root object at some point.
+     */
+    SoffitObject* ReadStream(std::istream& stream, const SoffitLimits& limits);
+
+    /**
+     * Parses an input stream within limits, as ReadStream, without throwing.
+     */
+    SoffitParseResult TryReadStream(std::istream& stream, const SoffitLimits& limits);
+
+    /**
+     * Parses an input stream into an existing root object, overwriting the document it held before.
+     * The existing objects and fields, and the capacity of their strings and vectors, are reused in document order,
+     * so parsing a document of the same shape as the last one allocates nothing.
+     * Objects and fields that are left over are deleted.
+     * Throws a SoffitException if the stream is malformed, leaving root holding an unspecified, but valid, document.
+     */
+    void ReadStreamInto(SoffitObject* root, std::istream& stream);
+
+    /**
+     * Parses an input stream into an existing root object, as ReadStreamInto, keeping left over nodes and the
+     * line buffers in context so that later parses can reuse them.
+     */
+    void ReadStreamInto(SoffitObject* root, std::istream& stream, SoffitParseContext& context);
+
+    /**
+     * Parses an input stream into an existing root object, as ReadStreamInto, without throwing.
+     * Returns false, with error filled in, if the stream is malformed.
+     */
+    bool TryReadStreamInto(SoffitObject* root, std::istream& stream, SoffitParseContext& context, SoffitError& error);
+
+    /**
+     * Writes a root SoffitObject to an output stream.
+     * Contains an optional flag to indent objects and fields based off of their nesting level.
+     * Indentation may be turned off in situations where the stream is not made to be primarily human readable.
+     * This will save a small amount of bandwidth/memory and time during writing, and conversly, re-parsing the data.
+     */
+    void WriteStream(SoffitObject* root, std::ostream& output, bool indent = true);
+
+    /**
+     * Writes a document as a binary image that LoadImage can open without parsing.
+     * Objects and fields are stored as fixed-size records that refer to one another and to a shared string pool
+     * by offset, along with indexes of each object's children and fields for lookup.  Open the stream in binary mode.
+     */
+    void SaveImage(SoffitObject* root, std::ostream& output);
+
+    /**
+     * Writes a document as a binary image to a file.  Throws a SoffitException if the file can not be written.
+     */
+    void SaveImage(SoffitObject* root, const std::string& path);
+
+    /**
+     * Maps an image written by SaveImage, read-only, and returns it without parsing or copying anything.
+     * With verifyChecksum the whole image is read once to check it.  Throws a SoffitException if the file can
+     * not be mapped or is not a valid image of this version.  Delete the returned image at some point.
+     */
+    SoffitImage* LoadImage(const std::string& path, bool verifyChecksum = false);
+
+    /**
+     * Opens an image held in memory, as LoadImage.  data must be 8-byte aligned, and must outlive the image.
+     */
+    SoffitImage* LoadImageFromMemory(const char* data, size_t size, bool verifyChecksum = false);
+
+    /**
+     * Writes a root SoffitObject to an output stream, as WriteStream, keeping the text written for every object.
+     * The next call writes the kept text of unchanged subtrees verbatim, and only serializes the objects that have
+     * been changed since, along with their ancestors, so rewriting a large document after a small edit is cheap.
+     * Each object keeps the text of its whole subtree, so the cache uses memory in proportion to the size of the
+     * document times its depth; dropWriteCache releases it.
+     */
+    void WriteStreamCached(SoffitObject* root, std::ostream& output, bool indent = true);
+
+    /**
+     * Writes a root SoffitObject to an output stream, as WriteStream, and fills stats with counters describing the write.
+     * Any previous contents of stats are overwritten.
+     */
+    void WriteStream(SoffitObject* root, std::ostream& output, SoffitStats& stats, bool indent = true);
+
+    /**
+     * Parses a string and returns a root SoffitObject pointer containing the parsed data.
+     * May throw a SoffitException for multiple reasons during input and parsing.
+     * Delete the returned root object at some point.
+     * If the root object is deleted, the destructor will also delete all child objects and fields.
+     */
+    SoffitObject* ReadStreamFromString(std::string& stream);
+
+    /**
+     * Parses a string, validating it against a compiled schema as each line is read.
+     * Throws a SoffitException at the first line that breaks the schema.
+     * Delete the returned root object at some point.
+     */
+    SoffitObject* ReadStreamFromString(std::string& stream, const SoffitSchema& schema);
+
+    /**
+     * Parses a string, building only the objects and fields selected by projection.
+     * Delete the returned root object at some point.
+     */
+    SoffitObject* ReadStreamFromString(std::string& stream, const SoffitProjection& projection);
+
+    /**
+     * Parses a string within limits, as ReadStream.
+     * Delete the returned root object at some point.
+     */
+    SoffitObject* ReadStreamFromString(std::string& stream, const SoffitLimits& limits);
+
+    /**
+     * Writes a root SoffitObject to a string.
+     * Contains an optional flag to indent objects and fields based off of their nesting level.
+     * Indentation may be turned off in situations where the stream is not made to be primarily human readable.
+     * This will save a small amount of bandwidth/memory and time during writing, and conversly, re-parsing the data.
+     */
+    std::string WriteStreamToString(SoffitObject* root, bool indent = true);
+
+    /**
+     * Converts a SOFFIT stream to JSON as it is read, with SoffitJsonWriter, without building a tree.
+     * Reading stops at the end of the footer's line, leaving anything after it in the input, such as another document.
+     * May throw a SoffitException for the same reasons as ReadStream.
+     * Lines longer than chunkThreshold are decoded as they arrive, as by SoffitPushParser::setChunkThreshold; 0 turns this off.
+     */
+    void SoffitToJson(std::istream& input, std::ostream& output, bool indent = true, size_t chunkThreshold = 1024 * 1024);
+
+    /**
+     * Converts JSON, in the form written by SoffitToJson, to SOFFIT as it is read, without building a tree.
+     * Each top level JSON object in the input becomes one SOFFIT stream.  Strings become fields, null becomes a field
+     * with no value, numbers and booleans become fields holding their text, and objects become SOFFIT objects typed by
+     * their key.  The elements of an array each take the array's key, and a string first member keyed by
+     * SOFFIT_JSON_NAME names its object.
+     * For any document, SoffitToJson followed by JsonToSoffit gives back a stream that parses to an equal tree.
+     * Throws a SoffitException for malformed JSON, nested arrays, keys that are not valid SOFFIT names,
+     * and strings holding a carriage return, which SOFFIT can not represent.
+     */
+    void JsonToSoffit(std::istream& input, std::ostream& output, bool indent = true);
+
+    /**
+     * Parses an input stream lazily and returns a root SoffitObject pointer containing the parsed data.
+     * The stream is read up to the footer and retained, and only the root's fields and objects are created.
+     * The body of each object is parsed the first time one of its fields or child objects is accessed.
+     * Structural errors throw a SoffitException here, but errors within a value (such as an invalid escape sequence)
+     * are only thrown once the object holding them is accessed.
+     * Delete the returned root object at some point.
+     */
+    SoffitObject* ReadStreamLazy(std::istream& stream);
+
+    /**
+     * Parses a string lazily and returns a root SoffitObject pointer containing the parsed data.
+     * See ReadStreamLazy.
+     * Delete the returned root object at some point.
+     */
+    SoffitObject* ReadStreamFromStringLazy(std::string& stream);
+
+    /**
+     * Parses an input stream until the first object matching the specified type and name has been read.
+     * Returns a pointer to the found object, detached from the rest of the parsed data.
+     * May throw a SoffitException for multiple reasons during input and parsing, or if the object is not found.
+     * Delete the returned object at some point.
+     */
+    SoffitObject* FindInStream(std::istream& stream, std::string type, std::string name);
+
+    /**
+     * Searches an input stream, as FindInStream, and fills stats with counters describing the search.
+     * Any previous contents of stats are overwritten.
+     */
+    SoffitObject* FindInStream(std::istream& stream, std::string type, std::string name, SoffitStats& stats);
+
+    /**
+     * Compares two trees and returns a patch that turns from into to when passed to ApplyPatch.
+     * The patch is itself a root SoffitObject, so it can be written with WriteStream and read back with ReadStream.
+     * Siblings are matched by type and name for objects, and by name for fields, pairing the nth occurrence in one tree
+     * with the nth occurrence in the other, so changing an object's name shows up as a removal and an addition.
+     * Matching is done with hash tables, so the cost is close to linear in the size of the trees.
+     * Neither tree is modified.  Delete the returned patch at some point.
+     */
+    SoffitObject* Diff(SoffitObject* from, SoffitObject* to);
+
+    /**
+     * Applies a patch produced by Diff to a live tree, in place.
+     * Objects and fields that are unchanged or only moved keep their addresses.
+     * Throws a SoffitException if the patch does not fit the tree.  Each Edit in the patch is checked before it is
+     * applied, but Edits before the one that does not fit will already have been applied.
+     */
+    void ApplyPatch(SoffitObject* root, SoffitObject* patch);
+
+    /**
+     * How Merge combines an overlay with its base.
+     * In every policy, child objects are matched by type and name and merged recursively, and anything in the overlay
+     * without a match in the base is added to it.
+     */
+    enum class SoffitMergePolicy {
+        /**
+         * A field in the overlay replaces the value of the base field with the same name.
+         * Repeated names are paired by occurrence, so the second field of a name replaces the second in the base.
+         */
+        Replace,
+
+        /**
+         * Every field in the overlay is added to the base, alongside any existing fields of the same name.
+         */
+        Append,
+
+        /**
+         * As Replace, but a field whose value is SOFFIT_DELETE, or an object holding a field named SOFFIT_DELETE,
+         * removes its match from the base instead.
+         */
+        DeleteMarker
+    };
+
+    /**
+     * Merges an overlay tree into a base tree, in place.
+     * Base objects and fields are never copied, and the parts of the overlay that are added to the base are moved
+     * rather than copied, leaving the overlay partially emptied.  Delete the overlay afterwards.
+     * Matching is done with hash tables, so the cost is linear in the size of the trees.
+     */
+    void Merge(SoffitObject* base, SoffitObject* overlay, SoffitMergePolicy policy = SoffitMergePolicy::Replace);
+
+    /**
+     * Calls preOrder and postOrder on root and every object beneath it, spreading subtrees across the threads of pool.
+     * preOrder is called on an object before any of its descendants, and postOrder after postOrder has been called
+     * on all of them; objects in different subtrees are visited concurrently and in no particular order.
+     * Either callback may be empty.  Wide objects are split in halves and deep subtrees are queued level by level,
+     * so idle threads always find work.  The first exception thrown by a callback, or by parsing a lazily read body,
+     * stops the traversal and is rethrown once the threads have finished.  Lazily read bodies are parsed by the thread
+     * that reaches them.
+     *
+     * Safe in a callback: reading the given object and anything beneath it; changing the values of its fields,
+     * and adding or deleting its fields; and, in postOrder, calling getHash() or equals() on it, since its
+     * descendants are finished.  Not safe: adding, deleting, detaching, renaming or re-typing any object,
+     * touching objects outside the given object's subtree, and recursive queries, which may build the index.
+     */
+    void ParallelForEach(SoffitObject* root, std::function<void(SoffitObject*)> preOrder, std::function<void(SoffitObject*)> postOrder, SoffitThreadPool& pool);
+
+    /**
+     * As ParallelForEach, using the shared pool.
+     */
+    void ParallelForEach(SoffitObject* root, std::function<void(SoffitObject*)> preOrder, std::function<void(SoffitObject*)> postOrder = nullptr);
+
+    /**
+     * Maps root and every object beneath it to a value in parallel, as ParallelForEach, and combines the values.
+     * combine must be associative and commutative, and identity must leave any value unchanged when combined with it.
+     * Each thread combines into its own partial result, so no locking is needed, and the partial results are
+     * combined when the traversal ends.  The same rules on mutation apply as for ParallelForEach.
+     */
+    template<typename T, typename Map, typename Combine>
+    T ParallelReduce(SoffitObject* root, T identity, Map map, Combine combine, SoffitThreadPool& pool) {
+        //Each partial result is kept on its own cache line, so that threads do not contend for it
+        struct alignas(64) Partial {
+            T value;
+        };
+        std::vector<Partial> partials(pool.getThreadCount(), Partial{ identity });
+
+        ParallelForEach(root, [&](SoffitObject* object) {
+            T& value = partials[SoffitThreadPool::currentWorker()].value;
+            value = combine(value, map(object));
+        }, nullptr, pool);
+
+        T result = identity;
+        for (size_t i = 0; i < partials.size(); i++)
+            result = combine(result, partials[i].value);
+
+        return result;
+    }
+
+    /**
+     * As ParallelReduce, using the shared pool.
+     */
+    template<typename T, typename Map, typename Combine>
+    T ParallelReduce(SoffitObject* root, T identity, Map map, Combine combine) {
+        return ParallelReduce(root, identity, map, combine, SoffitThreadPool::shared());
+    }
+
+    /**
+     * Returns the paths of the regular files in a directory whose names match pattern, sorted by path.
+     * In the pattern '*' matches any run of characters and '?' matches any single character.
+     * Subdirectories are not searched.  Throws a SoffitException if the directory can not be listed.
+     */
+    std::vector<std::string> FindFiles(const std::string& directory, const std::string& pattern = "*");
+
+    /**
+     * Parses a batch of SOFFIT files concurrently on the threads of pool, returning one result per path, in the
+     * same order as paths.  Each file is read in a single call and parsed as by TryReadStream, so a file that can
+     * not be read or parsed fails its own result, with SoffitErrorCode::FileNotReadable or the parse error,
+     * without affecting the rest of the batch.  Blocks until every file has been read.
+     */
+    std::vector<SoffitParseResult> ReadFiles(const std::vector<std::string>& paths, SoffitThreadPool& pool);
+
+    /**
+     * As ReadFiles, using the shared pool.
+     */
+    std::vector<SoffitParseResult> ReadFiles(const std::vector<std::string>& paths);
+
+    /**
+     * Moves the documents of a batch read by ReadFiles under a single new root, in input order.
+     * Each document becomes an object of the given type, named after its path, holding the fields and objects
+     * of the file.  Failed results are skipped and left in place, so their errors can still be read.
+     * Delete the returned root object at some point.
+     */
+    SoffitObject* CombineDocuments(std::vector<SoffitParseResult>& results, const std::vector<std::string>& paths, const std::string& type = "File");
+
+    //internal implementation
+
+    //What is left of a SoffitLimits during a parse, with every unset limit at its largest value
+    struct SoffitBudget {
+        uint64_t lineLength = UINT64_MAX;
+        uint64_t depth = UINT64_MAX;
+        uint64_t nodes = UINT64_MAX;
+        uint64_t bytes = UINT64_MAX;
+        uint64_t valueSize = UINT64_MAX;
+
+        SoffitBudget() = default;
+        SoffitBudget(const SoffitLimits& limits);
+    };
+
+    SoffitObject* _readStream(std::istream& stream, SoffitValidator* validator, SoffitStats* stats, SoffitError& error, const SoffitProjection* projection = nullptr, const SoffitLimits* limits = nullptr);
+    SoffitObject* _findStream(std::istream& stream, std::string type, std::string name, SoffitStats* stats, SoffitError& error);
+    void _writeStream(SoffitObject* root, std::ostream& output, bool indent, SoffitStats* stats);
+    void _writeObjects(SoffitObject* object, std::ostream& output, bool indent, SoffitStats* stats = nullptr);
+    bool _parseObject(std::istream& stream, SoffitObject* parent, int lineNumber, SoffitError& error, SoffitValidator* validator = nullptr, SoffitStats* stats = nullptr, const SoffitProjection* projection = nullptr, SoffitBudget* budget = nullptr);
+    SoffitObject* _findInStream(std::istream& stream, SoffitObject* parent, int lineNumber, std::string type, std::string name, SoffitError& error, SoffitStats* stats = nullptr);
+    bool _fail(SoffitError& error, SoffitErrorCode code, const std::string& message, int lineNumber = 0);
+    void _cleanObject(SoffitObject* root, SoffitObject* objToBeCleaned);
+    std::vector<std::string> _getLineTokens(std::string& line, int lineNumber);
+    void _getLineTokens(const std::string& line, std::vector<std::string>& tokens);
+    size_t _tokenizeLine(const std::string& line, std::vector<std::string>& tokens);
+    std::string _getLine(std::istream& stream, int& lineNumber, SoffitStats* stats = nullptr);
+    void _getLine(std::istream& stream, int& lineNumber, std::string& line, SoffitStats* stats = nullptr);
+    bool _getLine(std::istream& stream, int& lineNumber, std::string& line, SoffitStats* stats, SoffitBudget& budget, SoffitError& error);
+    bool _isObject(std::vector<std::string>& tokens);
+    bool _isObject(const std::vector<std::string>& tokens, size_t count);
+    bool _isField(std::vector<std::string>& tokens);
+    bool _isField(const std::vector<std::string>& tokens, size_t count);
+    std::string _convertFromEscapeSequence(const std::string& s, int lineNumber, SoffitStats* stats = nullptr);
+    void _convertFromEscapeSequenceInPlace(std::string& s, int lineNumber, SoffitStats* stats = nullptr);
+    bool _convertFromEscapeSequenceInPlace(std::string& s, int lineNumber, SoffitError& error, SoffitStats* stats = nullptr);
+    std::string _convertToEscapeSequence(const std::string& s);
+    const char* _findEscapeCharacter(const char* begin, const char* end);
+    size_t _escapedLength(const std::string& s);
+    void _writeEscaped(std::ostream& output, const std::string& s);
+    void _writeEscaped(std::ostream& output, const char* begin, const char* end);
+    void _appendEscaped(std::string& output, const std::string& s);
+    bool _parseInteger(const std::string& s, int64_t& out);
+    bool _parseDouble(const std::string& s, double& out);
+    bool _parseBool(const std::string& s, bool& out);
+    std::string _formatInteger(int64_t v);
+    std::string _formatDouble(double v);
+    void _skipObject(std::istream& stream, int& lineNumber);
+    bool _skipObject(std::istream& stream, int& lineNumber, std::string& line, SoffitError& error, SoffitStats* stats = nullptr);
+
+    //Adds the time since mark to a phase of stats, and moves mark to now
+    inline void _statsLap(SoffitStats* stats, double SoffitStats::* phase, std::chrono::steady_clock::time_point& mark) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        stats->*phase += std::chrono::duration<double>(now - mark).count();
+        mark = now;
+    }
+
+    enum class SoffitLineKind { Close, Footer, Object, Field, Invalid };
+    bool _nextLine(const char* data, size_t& pos, size_t end, int& lineNumber, size_t& lineBegin, size_t& lineEnd);
+    SoffitLineKind _classifyLine(const char* begin, const char* end);
+    void _parseLazyBody(SoffitObject* object, const std::shared_ptr<const std::string>& source, size_t begin, size_t end, int lineNumber, bool isRoot);
+    void _diffObjects(SoffitObject* from, SoffitObject* to, const std::string& path, SoffitObject* patch);
+    void _applyEdit(SoffitObject* target, SoffitObject* edit);
+    SoffitObject* _resolvePatchPath(SoffitObject* root, const std::string& path);
+    bool _readStreamInto(SoffitObject* root, std::istream& stream, SoffitParseContext& context, SoffitError& error);
+    void _mergeObjects(SoffitObject* base, SoffitObject* overlay, SoffitMergePolicy policy);
+    void _visitObjects(SoffitThreadPool& pool, const SoffitThreadPoolTask& task);
+    void _readFiles(SoffitThreadPool& pool, const SoffitThreadPoolTask& task);
+    bool _matchGlob(const std::string& pattern, const std::string& name);
+    std::vector<int> _matchSiblings(const std::vector<std::string>& fromKeys, const std::vector<std::string>& toKeys);
+    std::vector<bool> _stableSiblings(const std::vector<int>& toFrom);
+    size_t _heapUsage(const std::string& s);
+    uint64_t _hashString(const std::string& s);
+    uint64_t _hashBytes(const char* data, size_t length, uint64_t hash = 14695981039346656037ull);
+    uint64_t _hashCombine(uint64_t seed, uint64_t value);
     std::string _stripQuotations(std::string& s);
     std::string _stripWhitespace(std::string& s);
     bool _isTokenBlank(std::string token);
@@ -0,0 +1,216 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+
+namespace CPPSoffit {
+
+    // Reads straight from a buffer, so that a file read in one call is parsed without being copied again
+    class MemoryStreamBuffer : public std::streambuf {
+    public:
+        MemoryStreamBuffer(char* begin, char* end) {
+            setg(begin, begin, end);
+        }
+    };
+
+    struct BatchJob {
+        const std::vector<std::string>* paths;
+        std::vector<SoffitObject*> documents;
+        std::vector<SoffitError> errors;
+
+        std::atomic<size_t> pending;
+        std::mutex mutex;
+        std::condition_variable finished;
+        bool done = false;
+    };
+
+    std::vector<std::string> FindFiles(const std::string& directory, const std::string& pattern) {
+        std::vector<std::string> paths;
+
+        std::error_code code;
+        std::filesystem::directory_iterator it(directory, code);
+        if (code)
+            throw SoffitException("Could not list directory '" + directory + "'.");
+
+        for (; it != std::filesystem::directory_iterator(); it.increment(code)) {
+            if (!it->is_regular_file(code))
+                continue;
+            if (_matchGlob(pattern, it->path().filename().string()))
+                paths.push_back(it->path().string());
+        }
+
+        if (code)
+            throw SoffitException("Could not list directory '" + directory + "'.");
+
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
+
+    std::vector<SoffitParseResult> ReadFiles(const std::vector<std::string>& paths, SoffitThreadPool& pool) {
+        BatchJob job;
+        job.paths = &paths;
+        job.documents.resize(paths.size(), nullptr);
+        job.errors.resize(paths.size());
+        job.pending = paths.size();
+
+        if (!paths.empty()) {
+            pool.push({ _readFiles, &job, nullptr, 0, paths.size() });
+
+            std::unique_lock<std::mutex> lock(job.mutex);
+            job.finished.wait(lock, [&job] { return job.done; });
+        }
+
+        std::vector<SoffitParseResult> results;
+        results.reserve(paths.size());
+        for (size_t i = 0; i < paths.size(); i++) {
+            if (job.documents[i] != nullptr)
+                results.emplace_back(job.documents[i]);
+            else
+                results.emplace_back(std::move(job.errors[i]));
+        }
+
+        return results;
+    }
+
+    std::vector<SoffitParseResult> ReadFiles(const std::vector<std::string>& paths) {
+        return ReadFiles(paths, SoffitThreadPool::shared());
+    }
+
+    SoffitObject* CombineDocuments(std::vector<SoffitParseResult>& results, const std::vector<std::string>& paths, const std::string& type) {
+        SoffitObject* root = new SoffitObject("", "");
+
+        for (size_t i = 0; i < results.size(); i++) {
+            if (results[i].get() == nullptr)
+                continue;
+
+            SoffitObject* document = results[i].release();
+            document->setType(type);
+            document->setName(paths[i]);
+            root->add(document);
+        }
+
+        return root;
+    }
+
+    //************************************************
+    //*********BEGIN INTERNAL IMPLEMENTATION**********
+    //************************************************
+
+    // Reads a whole file in one call, reusing the capacity of contents.  Returns false if it can not be read
+    static bool _readFile(const std::string& path, std::string& contents) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+
+        file.seekg(0, std::ios::end);
+        std::streamoff size = file.tellg();
+        if (size < 0)
+            return false;
+        file.seekg(0, std::ios::beg);
+
+        contents.resize((size_t) size);
+        file.read(&contents[0], size);
+        return file.gcount() == size;
+    }
+
+    // Reads the files begin to end of a batch.  The upper half of the range is split off for other workers to
+    // steal until one file is left, as in _visitObjects, so that a few large files do not hold up the rest.
+    void _readFiles(SoffitThreadPool& pool, const SoffitThreadPoolTask& task) {
+        BatchJob* job = (BatchJob*) task.job;
+        size_t begin = task.begin;
+        size_t end = task.end;
+
+        while (end - begin > 1) {
+            size_t middle = begin + (end - begin) / 2;
+            pool.push({ _readFiles, job, nullptr, middle, end });
+            end = middle;
+        }
+
+        //Each worker keeps its read buffer, so that a batch of small files allocates one per thread
+        static thread_local std::string contents;
+        const std::string& path = (*job->paths)[begin];
+
+        if (!_readFile(path, contents)) {
+            _fail(job->errors[begin], SoffitErrorCode::FileNotReadable, "Could not read SOFFIT file '" + path + "'.");
+        }
+        else {
+            MemoryStreamBuffer buffer(&contents[0], &contents[0] + contents.size());
+            std::istream stream(&buffer);
+
+            SoffitParseResult result = TryReadStream(stream);
+            if (result.ok())
+                job->documents[begin] = result.release();
+            else
+                job->errors[begin] = result.getError();
+        }
+
+        if (job->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->done = true;
+            job->finished.notify_all();
+        }
+    }
+
+    // Matches a file name against a pattern in which '*' stands for any run of characters and '?' for any one
+    bool _matchGlob(const std::string& pattern, const std::string& name) {
+        size_t p = 0;
+        size_t n = 0;
+        size_t star = std::string::npos;
+        size_t resume = 0;
+
+        while (n < name.size()) {
+            if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+                p++;
+                n++;
+            }
+            else if (p < pattern.size() && pattern[p] == '*') {
+                star = p++;
+                resume = n;
+            }
+            else if (star != std::string::npos) {
+                //Let the last star swallow one more character, and try again from there
+                p = star + 1;
+                n = ++resume;
+            }
+            else {
+                return false;
+            }
+        }
+
+        while (p < pattern.size() && pattern[p] == '*')
+            p++;
+
+        return p == pattern.size();
+    }
+}
@@ -0,0 +1,508 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include "CPPSoffit.h"
+#include <tuple>
+#include <sstream>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+
+/**
+ * Compile-time binding of plain structs to SOFFIT objects.
+ *
+ * A struct is bound by specializing SoffitBinding with a constexpr tuple of member descriptors:
+ *
+ *     struct Service { std::string name; std::string date; };
+ *     SOFFIT_BINDING(Service,
+ *         CPPSoffit::SoffitBindName(&Service::name),
+ *         CPPSoffit::SoffitBindField("Date", &Service::date))
+ *
+ * ReadStreamBound() then fills the struct straight from the stream without building a SoffitObject tree,
+ * and WriteStreamBound() writes it back out using the same description.
+ */
+namespace CPPSoffit {
+
+    /**
+     * Specialize this for every bound struct, providing a static constexpr tuple named members.
+     * See SOFFIT_BINDING.
+     */
+    template<typename T>
+    struct SoffitBinding;
+
+    enum class SoffitBindKind { Field, Object, Name };
+
+    /**
+     * Describes how a single struct member maps to SOFFIT.
+     * Create these with SoffitBindField, SoffitBindObject and SoffitBindName.
+     */
+    template<typename C, typename M>
+    struct SoffitMember {
+        SoffitBindKind kind;
+        const char* key;
+        uint32_t hash;
+        M C::* member;
+    };
+
+    //FNV-1a, used to dispatch field names and object types without string compares
+    constexpr uint32_t _bindHash(const char* s, size_t length) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < length; i++) {
+            hash ^= (uint8_t) s[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    constexpr size_t _bindLength(const char* s) {
+        size_t length = 0;
+        while (s[length] != '\0')
+            length++;
+        return length;
+    }
+
+    /**
+     * Maps a member to a field.
+     * The member may be a std::string, int, int64_t, double, bool, or a std::vector of one of those for repeated fields.
+     */
+    template<typename C, typename M>
+    constexpr SoffitMember<C, M> SoffitBindField(const char* fieldName, M C::* member) {
+        return { SoffitBindKind::Field, fieldName, _bindHash(fieldName, _bindLength(fieldName)), member };
+    }
+
+    /**
+     * Maps a member to a child object of the specified type.
+     * The member must be a bound struct, or a std::vector of a bound struct for repeated objects.
+     */
+    template<typename C, typename M>
+    constexpr SoffitMember<C, M> SoffitBindObject(const char* objectType, M C::* member) {
+        return { SoffitBindKind::Object, objectType, _bindHash(objectType, _bindLength(objectType)), member };
+    }
+
+    /**
+     * Maps a std::string member to the name of the object itself.
+     */
+    template<typename C>
+    constexpr SoffitMember<C, std::string> SoffitBindName(std::string C::* member) {
+        return { SoffitBindKind::Name, "", 0, member };
+    }
+
+    /**
+     * Parses an input stream directly into a bound struct.
+     * Fields and objects that are not described by the binding are skipped.
+     * May throw a SoffitException for multiple reasons during input and parsing, including values that can not be converted.
+     */
+    template<typename T>
+    void ReadStreamBound(std::istream& stream, T& out);
+
+    /**
+     * Parses a string directly into a bound struct.
+     * May throw a SoffitException for multiple reasons during input and parsing.
+     */
+    template<typename T>
+    void ReadStreamBoundFromString(std::string& stream, T& out);
+
+    /**
+     * Writes a bound struct to an output stream as if it were the root object.
+     * Fields are written before child objects, in the order they are described by the binding.
+     */
+    template<typename T>
+    void WriteStreamBound(const T& root, std::ostream& output, bool indent = true);
+
+    /**
+     * Writes a bound struct to a string as if it were the root object.
+     */
+    template<typename T>
+    std::string WriteStreamBoundToString(const T& root, bool indent = true);
+
+    //**************************************
+    //******* INTERNAL IMPLEMENTATION *******
+    //**************************************
+
+    template<typename T>
+    struct _isBindVector : std::false_type {};
+
+    template<typename T>
+    struct _isBindVector<std::vector<T>> : std::true_type {};
+
+    template<typename T>
+    struct _bindElement { using type = T; };
+
+    template<typename T>
+    struct _bindElement<std::vector<T>> { using type = T; };
+
+    inline void _bindConvert(const std::string& value, std::string& out, int) {
+        out = value;
+    }
+
+    inline void _bindConvert(const std::string& value, int64_t& out, int lineNumber) {
+        if (!_parseInteger(value, out))
+            throw SoffitException("Bound field is not an integer.", lineNumber);
+    }
+
+    inline void _bindConvert(const std::string& value, int& out, int lineNumber) {
+        int64_t v;
+        if (!_parseInteger(value, v) || v < INT32_MIN || v > INT32_MAX)
+            throw SoffitException("Bound field is not an integer.", lineNumber);
+        out = (int) v;
+    }
+
+    inline void _bindConvert(const std::string& value, double& out, int lineNumber) {
+        if (!_parseDouble(value, out))
+            throw SoffitException("Bound field is not a number.", lineNumber);
+    }
+
+    inline void _bindConvert(const std::string& value, bool& out, int lineNumber) {
+        if (!_parseBool(value, out))
+            throw SoffitException("Bound field is not a boolean.", lineNumber);
+    }
+
+    inline std::string _bindFormat(const std::string& v) { return v; }
+    inline std::string _bindFormat(int64_t v) { return _formatInteger(v); }
+    inline std::string _bindFormat(int v) { return _formatInteger(v); }
+    inline std::string _bindFormat(double v) { return _formatDouble(v); }
+    inline std::string _bindFormat(bool v) { return v ? "true" : "false"; }
+
+    template<typename T>
+    constexpr size_t _bindMemberCount() {
+        return std::tuple_size<typename std::decay<decltype(SoffitBinding<T>::members)>::type>::value;
+    }
+
+    //Hashes only have to be unique among members of the same kind
+    template<typename T, size_t... I>
+    constexpr bool _bindHashesUnique(std::index_sequence<I...>) {
+        constexpr auto& members = SoffitBinding<T>::members;
+        const SoffitBindKind kinds[] = { std::get<I>(members).kind..., SoffitBindKind::Name };
+        const uint32_t hashes[] = { std::get<I>(members).hash..., 0 };
+
+        for (size_t i = 0; i < sizeof...(I); i++) {
+            for (size_t j = i + 1; j < sizeof...(I); j++) {
+                if (kinds[i] != SoffitBindKind::Name && kinds[i] == kinds[j] && hashes[i] == hashes[j])
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    //Line and token buffers shared by every level of one bound parse, so that their capacity is reused
+    struct SoffitBindBuffers {
+        std::string line;
+        std::vector<std::string> tokens;
+    };
+
+    template<typename T>
+    void _parseBound(std::istream& stream, T& out, int& lineNumber, bool isRoot, SoffitBindBuffers& buffers);
+
+    template<typename T, size_t I>
+    void _bindAssignName(T& out, const std::string& name) {
+        constexpr auto& member = std::get<I>(SoffitBinding<T>::members);
+        if constexpr (member.kind == SoffitBindKind::Name)
+            out.*(member.member) = name;
+    }
+
+    template<typename T, size_t... I>
+    void _bindName(T& out, const std::string& name, std::index_sequence<I...>) {
+        (_bindAssignName<T, I>(out, name), ...);
+    }
+
+    template<typename T, size_t I>
+    bool _bindFieldAt(T& out, uint32_t hash, const std::string& name, const std::string& value, int lineNumber) {
+        constexpr auto& member = std::get<I>(SoffitBinding<T>::members);
+
+        if constexpr (member.kind != SoffitBindKind::Field) {
+            return false;
+        }
+        else {
+            if (hash != member.hash || name != member.key)
+                return false;
+
+            auto& target = out.*(member.member);
+            using M = typename std::decay<decltype(target)>::type;
+            if constexpr (_isBindVector<M>::value) {
+                //Converted into a local, as std::vector<bool> has no bool& to convert into
+                typename M::value_type element{};
+                _bindConvert(value, element, lineNumber);
+                target.push_back(std::move(element));
+            }
+            else {
+                _bindConvert(value, target, lineNumber);
+            }
+            return true;
+        }
+    }
+
+    template<typename T, size_t I>
+    bool _bindObjectAt(T& out, uint32_t hash, const std::string& type, const std::string& name, std::istream& stream, int& lineNumber, SoffitBindBuffers& buffers) {
+        constexpr auto& member = std::get<I>(SoffitBinding<T>::members);
+
+        if constexpr (member.kind != SoffitBindKind::Object) {
+            return false;
+        }
+        else {
+            if (hash != member.hash || type != member.key)
+                return false;
+
+            auto& target = out.*(member.member);
+            using M = typename std::decay<decltype(target)>::type;
+            if constexpr (_isBindVector<M>::value) {
+                target.emplace_back();
+                _bindName(target.back(), name, std::make_index_sequence<_bindMemberCount<typename M::value_type>()>());
+                _parseBound(stream, target.back(), lineNumber, false, buffers);
+            }
+            else {
+                _bindName(target, name, std::make_index_sequence<_bindMemberCount<M>()>());
+                _parseBound(stream, target, lineNumber, false, buffers);
+            }
+            return true;
+        }
+    }
+
+    template<typename T, size_t... I>
+    bool _bindFieldDispatch(T& out, const std::string& name, const std::string& value, int lineNumber, std::index_sequence<I...>) {
+        uint32_t hash = _bindHash(name.data(), name.size());
+        return (_bindFieldAt<T, I>(out, hash, name, value, lineNumber) || ...);
+    }
+
+    template<typename T, size_t... I>
+    bool _bindObjectDispatch(T& out, const std::string& type, const std::string& name, std::istream& stream, int& lineNumber, SoffitBindBuffers& buffers, std::index_sequence<I...>) {
+        uint32_t hash = _bindHash(type.data(), type.size());
+        return (_bindObjectAt<T, I>(out, hash, type, name, stream, lineNumber, buffers) || ...);
+    }
+
+    template<typename T>
+    void _parseBound(std::istream& stream, T& out, int& lineNumber, bool isRoot, SoffitBindBuffers& buffers) {
+        constexpr size_t count = _bindMemberCount<T>();
+        static_assert(_bindHashesUnique<T>(std::make_index_sequence<count>()),
+            "SOFFIT binding contains duplicate or colliding field names or object types.");
+
+        std::string& line = buffers.line;
+        std::vector<std::string>& tokens = buffers.tokens;
+
+        while (true) {
+            _getLine(stream, lineNumber, line);
+
+            if (line.empty())
+                throw SoffitException("Incomplete SOFFIT stream.");
+
+            _getLineTokens(line, tokens);
+
+            //Ensure there are no double quotes in first token (The first token would be an object type or field name)
+            if (_containsCharacter(tokens[0], '"'))
+                throw SoffitException("SOFFIT syntax error.", lineNumber);
+
+            if (tokens.size() == 1 && tokens[0] == "}") {
+                if (isRoot)
+                    throw SoffitException("Too many closing brackets.", lineNumber);
+                return;
+            }
+            else if (tokens[0] == SOFFIT_END) {
+                if (!isRoot)
+                    throw SoffitException("SOFFIT footer encountered in non-root object.", lineNumber);
+                return;
+            }
+            else if (_isObject(tokens)) {
+                std::string objName = "";
+                if (tokens.size() == 3) {
+                    objName = _stripQuotations(tokens[1]);
+                    _convertFromEscapeSequenceInPlace(objName, lineNumber);
+                }
+
+                //A matched child is parsed with the same buffers, so tokens is not used again once it has been dispatched
+                if (!_bindObjectDispatch(out, tokens[0], objName, stream, lineNumber, buffers, std::make_index_sequence<count>()))
+                    _skipObject(stream, lineNumber);
+            }
+            else if (_isField(tokens)) {
+                std::string fieldValue = "";
+                if (tokens.size() > 1) {
+                    fieldValue = _stripQuotations(tokens[1]);
+                    _convertFromEscapeSequenceInPlace(fieldValue, lineNumber);
+                }
+
+                _bindFieldDispatch(out, tokens[0], fieldValue, lineNumber, std::make_index_sequence<count>());
+            }
+            else {
+                throw SoffitException("SOFFIT syntax error.", lineNumber);
+            }
+        }
+    }
+
+    inline void _writeBoundIndent(std::ostream& output, int nestingLevel, bool indent) {
+        if (indent) {
+            for (int i = 0; i < nestingLevel; i++)
+                output << "\t";
+        }
+    }
+
+    inline void _writeBoundField(const char* name, const std::string& value, std::ostream& output, int nestingLevel, bool indent) {
+        _writeBoundIndent(output, nestingLevel, indent);
+
+        output << name;
+        if (value != "") {
+            output << " " << "\"";
+            _writeEscaped(output, value);
+            output << "\"\n";
+        }
+        else {
+            output << "\n";
+        }
+    }
+
+    template<typename T>
+    void _writeBound(const T& object, std::ostream& output, int nestingLevel, bool indent);
+
+    template<typename T, size_t I>
+    void _boundNameAt(const T& object, std::string& name) {
+        constexpr auto& member = std::get<I>(SoffitBinding<T>::members);
+        if constexpr (member.kind == SoffitBindKind::Name)
+            name = object.*(member.member);
+    }
+
+    template<typename T, size_t... I>
+    std::string _boundName(const T& object, std::index_sequence<I...>) {
+        std::string name = "";
+        (_boundNameAt<T, I>(object, name), ...);
+        return name;
+    }
+
+    template<typename T>
+    void _writeBoundObject(const char* type, const T& object, std::ostream& output, int nestingLevel, bool indent) {
+        _writeBoundIndent(output, nestingLevel, indent);
+
+        std::string name = _boundName(object, std::make_index_sequence<_bindMemberCount<T>()>());
+        output << type;
+        if (name != "") {
+            output << " " << "\"";
+            _writeEscaped(output, name);
+            output << "\" {\n";
+        }
+        else {
+            output << " {\n";
+        }
+
+        _writeBound(object, output, nestingLevel + 1, indent);
+
+        _writeBoundIndent(output, nestingLevel, indent);
+        output << "}\n";
+    }
+
+    template<typename T, size_t I>
+    void _writeBoundFieldAt(const T& object, std::ostream& output, int nestingLevel, bool indent) {
+        constexpr auto& member = std::get<I>(SoffitBinding<T>::members);
+
+        if constexpr (member.kind == SoffitBindKind::Field) {
+            const auto& source = object.*(member.member);
+            using M = typename std::decay<decltype(source)>::type;
+            if constexpr (_isBindVector<M>::value) {
+                for (const auto& v : source)
+                    _writeBoundField(member.key, _bindFormat(v), output, nestingLevel, indent);
+            }
+            else {
+                _writeBoundField(member.key, _bindFormat(source), output, nestingLevel, indent);
+            }
+        }
+    }
+
+    template<typename T, size_t I>
+    void _writeBoundObjectAt(const T& object, std::ostream& output, int nestingLevel, bool indent) {
+        constexpr auto& member = std::get<I>(SoffitBinding<T>::members);
+
+        if constexpr (member.kind == SoffitBindKind::Object) {
+            const auto& source = object.*(member.member);
+            using M = typename std::decay<decltype(source)>::type;
+            if constexpr (_isBindVector<M>::value) {
+                for (const auto& child : source)
+                    _writeBoundObject(member.key, child, output, nestingLevel, indent);
+            }
+            else {
+                _writeBoundObject(member.key, source, output, nestingLevel, indent);
+            }
+        }
+    }
+
+    template<typename T, size_t... I>
+    void _writeBoundMembers(const T& object, std::ostream& output, int nestingLevel, bool indent, std::index_sequence<I...>) {
+        // Write fields
+        (_writeBoundFieldAt<T, I>(object, output, nestingLevel, indent), ...);
+
+        // Write nested objects
+        (_writeBoundObjectAt<T, I>(object, output, nestingLevel, indent), ...);
+    }
+
+    template<typename T>
+    void _writeBound(const T& object, std::ostream& output, int nestingLevel, bool indent) {
+        _writeBoundMembers(object, output, nestingLevel, indent, std::make_index_sequence<_bindMemberCount<T>()>());
+    }
+
+    template<typename T>
+    void ReadStreamBound(std::istream& stream, T& out) {
+        int lineNumber = 0;
+
+        std::string header = _getLine(stream, lineNumber);
+        if (header != SOFFIT_START)
+            throw SoffitException("SOFFIT header not found.");
+
+        SoffitBindBuffers buffers;
+        _parseBound(stream, out, lineNumber, true, buffers);
+    }
+
+    template<typename T>
+    void ReadStreamBoundFromString(std::string& stream, T& out) {
+        std::istringstream iss(stream);
+        ReadStreamBound(iss, out);
+    }
+
+    template<typename T>
+    void WriteStreamBound(const T& root, std::ostream& output, bool indent) {
+        output << SOFFIT_START << "\n";
+        _writeBound(root, output, 0, indent);
+        output << SOFFIT_END << "\n";
+    }
+
+    template<typename T>
+    std::string WriteStreamBoundToString(const T& root, bool indent) {
+        std::ostringstream oss;
+        WriteStreamBound(root, oss, indent);
+        return oss.str();
+    }
+}
+
+/**
+ * Binds a struct to SOFFIT.  Use at global scope, after the struct has been defined.
+ * The remaining arguments are member descriptors created with SoffitBindField, SoffitBindObject and SoffitBindName.
+ */
+#define SOFFIT_BINDING(Type, ...) \
+    namespace CPPSoffit { \
+        template<> \
+        struct SoffitBinding<Type> { \
+            static constexpr auto members = std::make_tuple(__VA_ARGS__); \
+        }; \
+    }
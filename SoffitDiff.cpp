@@ -0,0 +1,397 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+#include <algorithm>
+
+namespace CPPSoffit {
+
+    SoffitObject* Diff(SoffitObject* from, SoffitObject* to) {
+        SoffitObject* patch = new SoffitObject("", "");
+        _diffObjects(from, to, "", patch);
+        return patch;
+    }
+
+    void ApplyPatch(SoffitObject* root, SoffitObject* patch) {
+        std::vector<SoffitObject*> edits = patch->getAllObjects();
+        for (size_t i = 0; i < edits.size(); i++) {
+            if (edits[i]->getType() != "Edit")
+                throw SoffitException("Unknown patch entry: " + edits[i]->getType());
+
+            _applyEdit(_resolvePatchPath(root, edits[i]->getName()), edits[i]);
+        }
+    }
+
+    //************************************************
+    //*********BEGIN INTERNAL IMPLEMENTATION**********
+    //************************************************
+
+    // Returns the Edit for the object at path, adding it to the patch if this is its first operation
+    static SoffitObject* _patchEdit(SoffitObject* patch, SoffitObject*& edit, const std::string& path) {
+        if (edit == nullptr) {
+            edit = new SoffitObject("Edit", path);
+            patch->add(edit);
+        }
+        return edit;
+    }
+
+    // Emits the operations for one object, then recurses into the child objects that were matched.
+    // Paths are indices into the target tree, which is valid because a parent's Edit always precedes its children's.
+    void _diffObjects(SoffitObject* from, SoffitObject* to, const std::string& path, SoffitObject* patch) {
+        if (!from->isBodyParsed())
+            from->parseLazyBody();
+        if (!to->isBodyParsed())
+            to->parseLazyBody();
+
+        SoffitObject* edit = nullptr;
+
+        //Fields are keyed by name
+        std::vector<std::string> fromKeys;
+        std::vector<std::string> toKeys;
+        fromKeys.reserve(from->fields.size());
+        toKeys.reserve(to->fields.size());
+        for (size_t i = 0; i < from->fields.size(); i++)
+            fromKeys.push_back(from->fields[i]->getName());
+        for (size_t i = 0; i < to->fields.size(); i++)
+            toKeys.push_back(to->fields[i]->getName());
+
+        std::vector<int> toFrom = _matchSiblings(fromKeys, toKeys);
+        std::vector<bool> stable = _stableSiblings(toFrom);
+        std::vector<bool> matched(fromKeys.size(), false);
+        for (size_t j = 0; j < toFrom.size(); j++) {
+            if (toFrom[j] >= 0)
+                matched[toFrom[j]] = true;
+        }
+
+        for (size_t i = 0; i < matched.size(); i++) {
+            if (!matched[i])
+                _patchEdit(patch, edit, path)->add(new SoffitField("RemoveField", std::to_string(i)));
+        }
+
+        for (size_t j = 0; j < toFrom.size(); j++) {
+            SoffitField* field = to->fields[j];
+            if (toFrom[j] < 0) {
+                SoffitObject* insert = new SoffitObject("InsertField", std::to_string(j));
+                insert->add(new SoffitField(field->getName(), field->getValue()));
+                _patchEdit(patch, edit, path)->add(insert);
+                continue;
+            }
+
+            if (!stable[j])
+                _patchEdit(patch, edit, path)->add(new SoffitField("MoveField", std::to_string(toFrom[j]) + " " + std::to_string(j)));
+            if (from->fields[toFrom[j]]->getValue() != field->getValue())
+                _patchEdit(patch, edit, path)->add(new SoffitField("SetField", std::to_string(j) + " " + field->getValue()));
+        }
+
+        //Objects are keyed by type and name.  Types can not contain a null character, so the key is unambiguous
+        fromKeys.clear();
+        toKeys.clear();
+        fromKeys.reserve(from->objects.size());
+        toKeys.reserve(to->objects.size());
+        for (size_t i = 0; i < from->objects.size(); i++)
+            fromKeys.push_back(from->objects[i]->type + '\0' + from->objects[i]->name);
+        for (size_t i = 0; i < to->objects.size(); i++)
+            toKeys.push_back(to->objects[i]->type + '\0' + to->objects[i]->name);
+
+        toFrom = _matchSiblings(fromKeys, toKeys);
+        stable = _stableSiblings(toFrom);
+        matched.assign(fromKeys.size(), false);
+        for (size_t j = 0; j < toFrom.size(); j++) {
+            if (toFrom[j] >= 0)
+                matched[toFrom[j]] = true;
+        }
+
+        for (size_t i = 0; i < matched.size(); i++) {
+            if (!matched[i])
+                _patchEdit(patch, edit, path)->add(new SoffitField("RemoveObject", std::to_string(i)));
+        }
+
+        for (size_t j = 0; j < toFrom.size(); j++) {
+            if (toFrom[j] < 0) {
+                SoffitObject* insert = new SoffitObject("InsertObject", std::to_string(j));
+                insert->add(to->objects[j]->clone());
+                _patchEdit(patch, edit, path)->add(insert);
+            }
+            else if (!stable[j]) {
+                _patchEdit(patch, edit, path)->add(new SoffitField("MoveObject", std::to_string(toFrom[j]) + " " + std::to_string(j)));
+            }
+        }
+
+        //Matched subtrees with equal hashes are unchanged, and are not visited at all
+        for (size_t j = 0; j < toFrom.size(); j++) {
+            if (toFrom[j] >= 0 && from->objects[toFrom[j]]->getHash() != to->objects[j]->getHash())
+                _diffObjects(from->objects[toFrom[j]], to->objects[j], path.empty() ? std::to_string(j) : path + "/" + std::to_string(j), patch);
+        }
+    }
+
+    // Pairs the nth occurrence of each key in toKeys with the nth occurrence in fromKeys.
+    // Returns, for each entry of toKeys, the index of its match in fromKeys, or -1 if it has none.
+    std::vector<int> _matchSiblings(const std::vector<std::string>& fromKeys, const std::vector<std::string>& toKeys) {
+        struct Occurrences {
+            std::vector<int> indices;
+            size_t next = 0;
+        };
+
+        std::unordered_map<std::string, Occurrences> occurrences;
+        occurrences.reserve(fromKeys.size());
+        for (size_t i = 0; i < fromKeys.size(); i++)
+            occurrences[fromKeys[i]].indices.push_back((int)i);
+
+        std::vector<int> toFrom(toKeys.size(), -1);
+        for (size_t j = 0; j < toKeys.size(); j++) {
+            std::unordered_map<std::string, Occurrences>::iterator found = occurrences.find(toKeys[j]);
+            if (found != occurrences.end() && found->second.next < found->second.indices.size())
+                toFrom[j] = found->second.indices[found->second.next++];
+        }
+
+        return toFrom;
+    }
+
+    // Marks the matched siblings that keep their relative order, being the longest increasing run of source indices.
+    // Every other matched sibling has to be moved.
+    std::vector<bool> _stableSiblings(const std::vector<int>& toFrom) {
+        std::vector<int> tails;
+        std::vector<int> previous(toFrom.size(), -1);
+
+        for (size_t j = 0; j < toFrom.size(); j++) {
+            if (toFrom[j] < 0)
+                continue;
+
+            size_t low = 0;
+            size_t high = tails.size();
+            while (low < high) {
+                size_t middle = (low + high) / 2;
+                if (toFrom[tails[middle]] < toFrom[j])
+                    low = middle + 1;
+                else
+                    high = middle;
+            }
+
+            if (low > 0)
+                previous[j] = tails[low - 1];
+            if (low == tails.size())
+                tails.push_back((int)j);
+            else
+                tails[low] = (int)j;
+        }
+
+        std::vector<bool> stable(toFrom.size(), false);
+        for (int j = tails.empty() ? -1 : tails.back(); j >= 0; j = previous[j])
+            stable[j] = true;
+
+        return stable;
+    }
+
+    SoffitObject* _resolvePatchPath(SoffitObject* root, const std::string& path) {
+        SoffitObject* object = root;
+        size_t begin = 0;
+
+        while (begin < path.size()) {
+            size_t end = path.find('/', begin);
+            if (end == std::string::npos)
+                end = path.size();
+
+            if (!object->isBodyParsed())
+                object->parseLazyBody();
+
+            int64_t index;
+            if (!_parseInteger(path.substr(begin, end - begin), index) || index < 0 || index >= (int64_t)object->objects.size())
+                throw SoffitException("Patch path does not exist: " + path);
+
+            object = object->objects[index];
+            begin = end + 1;
+        }
+
+        return object;
+    }
+
+    // Parses a patch operand holding an index, optionally followed by a space and a second index or a value
+    static int64_t _patchIndex(const std::string& operand, std::string* rest) {
+        size_t space = operand.find(' ');
+        int64_t index;
+        if (!_parseInteger(operand.substr(0, space), index) || index < 0)
+            throw SoffitException("Invalid patch operand: " + operand);
+
+        if (rest != nullptr) {
+            if (space == std::string::npos)
+                throw SoffitException("Invalid patch operand: " + operand);
+            *rest = operand.substr(space + 1);
+        }
+        return index;
+    }
+
+    // Works out the new order of a sibling vector.  Each entry is an index into the current vector,
+    // or -1 - k for the kth insertion.  Throws, without modifying anything, if the operations do not fit.
+    static std::vector<int> _planSiblings(size_t count, const std::vector<int64_t>& removes,
+                                          const std::vector<std::pair<int64_t, int64_t>>& moves,
+                                          const std::vector<int64_t>& inserts) {
+        std::vector<bool> taken(count, false);
+        for (size_t i = 0; i < removes.size(); i++) {
+            if (removes[i] >= (int64_t)count || taken[removes[i]])
+                throw SoffitException("Patch does not fit: invalid removal " + std::to_string(removes[i]));
+            taken[removes[i]] = true;
+        }
+        for (size_t i = 0; i < moves.size(); i++) {
+            if (moves[i].first >= (int64_t)count || taken[moves[i].first])
+                throw SoffitException("Patch does not fit: invalid move " + std::to_string(moves[i].first));
+            taken[moves[i].first] = true;
+        }
+
+        size_t newCount = count - removes.size() + inserts.size();
+        std::vector<int> order(newCount, INT32_MIN);
+        for (size_t i = 0; i < moves.size(); i++) {
+            if (moves[i].second >= (int64_t)newCount || order[moves[i].second] != INT32_MIN)
+                throw SoffitException("Patch does not fit: invalid move target " + std::to_string(moves[i].second));
+            order[moves[i].second] = (int)moves[i].first;
+        }
+        for (size_t k = 0; k < inserts.size(); k++) {
+            if (inserts[k] >= (int64_t)newCount || order[inserts[k]] != INT32_MIN)
+                throw SoffitException("Patch does not fit: invalid insertion " + std::to_string(inserts[k]));
+            order[inserts[k]] = -1 - (int)k;
+        }
+
+        //The remaining slots are filled by the untouched siblings, in their current order
+        size_t next = 0;
+        for (size_t j = 0; j < newCount; j++) {
+            if (order[j] != INT32_MIN)
+                continue;
+
+            while (taken[next])
+                next++;
+            order[j] = (int)next++;
+        }
+
+        return order;
+    }
+
+    void _applyEdit(SoffitObject* target, SoffitObject* edit) {
+        if (!target->isBodyParsed())
+            target->parseLazyBody();
+
+        std::vector<int64_t> fieldRemoves;
+        std::vector<std::pair<int64_t, int64_t>> fieldMoves;
+        std::vector<std::pair<int64_t, std::string>> fieldSets;
+        std::vector<int64_t> fieldInserts;
+        std::vector<SoffitField*> insertedFields;
+        std::vector<int64_t> objectRemoves;
+        std::vector<std::pair<int64_t, int64_t>> objectMoves;
+        std::vector<int64_t> objectInserts;
+        std::vector<SoffitObject*> insertedObjects;
+
+        std::vector<SoffitField*> operations = edit->getAllFields();
+        for (size_t i = 0; i < operations.size(); i++) {
+            std::string operation = operations[i]->getName();
+            std::string operand = operations[i]->getValue();
+            std::string rest;
+
+            if (operation == "RemoveField") {
+                fieldRemoves.push_back(_patchIndex(operand, nullptr));
+            }
+            else if (operation == "RemoveObject") {
+                objectRemoves.push_back(_patchIndex(operand, nullptr));
+            }
+            else if (operation == "MoveField" || operation == "MoveObject") {
+                int64_t source = _patchIndex(operand, &rest);
+                std::pair<int64_t, int64_t> move(source, _patchIndex(rest, nullptr));
+                (operation == "MoveField" ? fieldMoves : objectMoves).push_back(move);
+            }
+            else if (operation == "SetField") {
+                int64_t index = _patchIndex(operand, &rest);
+                fieldSets.push_back(std::pair<int64_t, std::string>(index, rest));
+            }
+            else {
+                throw SoffitException("Unknown patch operation: " + operation);
+            }
+        }
+
+        std::vector<SoffitObject*> inserts = edit->getAllObjects();
+        for (size_t i = 0; i < inserts.size(); i++) {
+            if (inserts[i]->getType() == "InsertField" && inserts[i]->getAllFields().size() == 1) {
+                fieldInserts.push_back(_patchIndex(inserts[i]->getName(), nullptr));
+                insertedFields.push_back(inserts[i]->getAllFields()[0]);
+            }
+            else if (inserts[i]->getType() == "InsertObject" && inserts[i]->getAllObjects().size() == 1) {
+                objectInserts.push_back(_patchIndex(inserts[i]->getName(), nullptr));
+                insertedObjects.push_back(inserts[i]->getAllObjects()[0]);
+            }
+            else {
+                throw SoffitException("Invalid patch insertion: " + inserts[i]->getType());
+            }
+        }
+
+        //Check everything before changing anything
+        std::vector<int> fieldOrder = _planSiblings(target->fields.size(), fieldRemoves, fieldMoves, fieldInserts);
+        std::vector<int> objectOrder = _planSiblings(target->objects.size(), objectRemoves, objectMoves, objectInserts);
+        for (size_t i = 0; i < fieldSets.size(); i++) {
+            if (fieldSets[i].first >= (int64_t)fieldOrder.size())
+                throw SoffitException("Patch does not fit: invalid field " + std::to_string(fieldSets[i].first));
+        }
+
+        std::vector<SoffitField*> fields;
+        fields.reserve(fieldOrder.size());
+        for (size_t j = 0; j < fieldOrder.size(); j++) {
+            if (fieldOrder[j] >= 0) {
+                fields.push_back(target->fields[fieldOrder[j]]);
+            }
+            else {
+                SoffitField* source = insertedFields[-1 - fieldOrder[j]];
+                SoffitField* field = new SoffitField(source->getName(), source->getValue());
+                field->setParent(target);
+                fields.push_back(field);
+            }
+        }
+        for (size_t i = 0; i < fieldRemoves.size(); i++)
+            delete target->fields[fieldRemoves[i]];
+        target->fields.swap(fields);
+
+        for (size_t i = 0; i < fieldSets.size(); i++)
+            target->fields[fieldSets[i].first]->setValue(fieldSets[i].second);
+
+        std::vector<SoffitObject*> objects;
+        objects.reserve(objectOrder.size());
+        for (size_t j = 0; j < objectOrder.size(); j++) {
+            if (objectOrder[j] >= 0) {
+                objects.push_back(target->objects[objectOrder[j]]);
+            }
+            else {
+                SoffitObject* object = insertedObjects[-1 - objectOrder[j]]->clone();
+                object->setParent(target);
+                objects.push_back(object);
+            }
+        }
+        for (size_t i = 0; i < objectRemoves.size(); i++)
+            delete target->objects[objectRemoves[i]];
+        target->objects.swap(objects);
+
+        target->invalidateHash();
+        target->dropIndex();
+    }
+}
@@ -0,0 +1,180 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+#include <algorithm>
+
+namespace CPPSoffit {
+    SoffitDocumentReader::SoffitDocumentReader(std::istream& stream, size_t bufferSize) : stream(stream) {
+        buffer.resize(bufferSize > 0 ? bufferSize : 1);
+    }
+
+    SoffitObject* SoffitDocumentReader::next() {
+        parser.reset();
+
+        //Drop the rest of a document that failed, rather than feeding it again
+        if (skipLines > 0 && !skipDocument())
+            return nullptr;
+
+        while (true) {
+            if (bufferBegin == bufferEnd && !fillBuffer()) {
+                //End of input between documents
+                if (!parser.hasStarted())
+                    return nullptr;
+                break;
+            }
+
+            int linesBefore = parser.getLineNumber();
+            try {
+                bufferBegin += parser.feed(buffer.data() + bufferBegin, bufferEnd - bufferBegin);
+            }
+            catch (...) {
+                //The failing line ends at the first line terminator not yet fed, or, if it started in an earlier
+                //fragment and is still being streamed, at the next one in this fragment
+                skipLines = std::max(parser.getLineNumber() - linesBefore, 1);
+                throw;
+            }
+
+            if (parser.isComplete())
+                break;
+        }
+
+        SoffitObject* root = parser.finish();
+        documentCount++;
+        return root;
+    }
+
+    size_t SoffitDocumentReader::nextBatch(std::vector<SoffitObject*>& documents, size_t count) {
+        size_t read = 0;
+
+        while (read < count) {
+            SoffitObject* root = next();
+            if (root == nullptr)
+                break;
+
+            documents.push_back(root);
+            read++;
+        }
+
+        return read;
+    }
+
+    uint64_t SoffitDocumentReader::getDocumentCount() {
+        return documentCount;
+    }
+
+    // Skip past the line that failed and any lines after it, up to the next header line, which is left to be fed.
+    // A header line split between reads is matched as it arrives, and the part already read is fed to the parser.
+    // Returns false if the input ends first
+    bool SoffitDocumentReader::skipDocument() {
+        size_t lineBegin = bufferBegin;
+        bool lineInBuffer = true;
+        size_t matched = 0;
+        bool candidate = true;
+
+        while (true) {
+            if (bufferBegin == bufferEnd) {
+                bool atLineStart = lineBegin == bufferBegin;
+                if (!fillBuffer()) {
+                    skipLines = 0;
+                    return false;
+                }
+                lineBegin = 0;
+                lineInBuffer = atLineStart;
+            }
+
+            char c = buffer[bufferBegin];
+
+            if (c == '\n' || c == '\r') {
+                if (skipLines > 0) {
+                    skipLines--;
+                }
+                else if (candidate && matched == SOFFIT_START.size()) {
+                    if (lineInBuffer)
+                        bufferBegin = lineBegin;
+                    else
+                        parser.feed(SOFFIT_START.data(), SOFFIT_START.size());
+                    return true;
+                }
+
+                bufferBegin++;
+                lineBegin = bufferBegin;
+                lineInBuffer = true;
+                matched = 0;
+                candidate = true;
+                continue;
+            }
+
+            //Match the header, allowing the whitespace around it that the parser strips
+            if (skipLines == 0 && candidate) {
+                if (c == ' ' || c == '\t') {
+                    if (matched != 0 && matched != SOFFIT_START.size())
+                        candidate = false;
+                }
+                else if (matched < SOFFIT_START.size() && c == SOFFIT_START[matched]) {
+                    matched++;
+                }
+                else {
+                    candidate = false;
+                }
+            }
+
+            bufferBegin++;
+        }
+    }
+
+    // Refill the buffer with whatever is available, blocking only until at least one byte arrives
+    bool SoffitDocumentReader::fillBuffer() {
+        bufferBegin = 0;
+        bufferEnd = 0;
+
+        std::streamsize available = stream.readsome(buffer.data(), (std::streamsize) buffer.size());
+        if (available > 0) {
+            bufferEnd = (size_t) available;
+            return true;
+        }
+
+        int c = stream.get();
+        if (c == std::char_traits<char>::eof())
+            return false;
+
+        buffer[0] = (char) c;
+        bufferEnd = 1;
+
+        if (buffer.size() > 1) {
+            available = stream.readsome(buffer.data() + 1, (std::streamsize) buffer.size() - 1);
+            if (available > 0)
+                bufferEnd += (size_t) available;
+        }
+
+        return true;
+    }
+}
@@ -53,6 +53,17 @@ namespace CPPSoffit {
         this->message = oss.str();
     }
 
+    SoffitException::SoffitException(const SoffitError& error) {
+        if (error.lineNumber > 0) {
+            std::ostringstream oss;
+            oss << "SOFFIT Stream, line " << error.lineNumber << ": " << error.message;
+            this->message = oss.str();
+        }
+        else {
+            this->message = error.message;
+        }
+    }
+
     const char* SoffitException::what() const noexcept {
         return message.c_str();
     }
@@ -31,6 +31,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "CPPSoffit.h"
 #include <string>
+#include <climits>
 
 namespace CPPSoffit {
     SoffitField::SoffitField(std::string name, std::string value) {
@@ -68,9 +69,122 @@ namespace CPPSoffit {
 
     void SoffitField::setValue(std::string v) {
         value = v;
+        parsedFlags = 0;
+
+        if (parent != nullptr)
+            parent->invalidateHash();
+    }
+
+    template<>
+    bool SoffitField::getValueAs<int64_t>(int64_t& out) {
+        if (!(parsedFlags & INTEGER_PARSED)) {
+            int64_t parsed;
+            parsedFlags = (parsedFlags & ~(DOUBLE_PARSED | DOUBLE_VALID)) | INTEGER_PARSED;
+            if (_parseInteger(value, parsed)) {
+                parsedFlags |= INTEGER_VALID;
+                parsedInteger = parsed;
+            }
+        }
+
+        if (!(parsedFlags & INTEGER_VALID))
+            return false;
+
+        out = parsedInteger;
+        return true;
+    }
+
+    template<>
+    bool SoffitField::getValueAs<int>(int& out) {
+        int64_t v;
+        if (!getValueAs<int64_t>(v) || v < INT_MIN || v > INT_MAX)
+            return false;
+
+        out = (int) v;
+        return true;
+    }
+
+    template<>
+    bool SoffitField::getValueAs<double>(double& out) {
+        if (!(parsedFlags & DOUBLE_PARSED)) {
+            double parsed;
+            parsedFlags = (parsedFlags & ~(INTEGER_PARSED | INTEGER_VALID)) | DOUBLE_PARSED;
+            if (_parseDouble(value, parsed)) {
+                parsedFlags |= DOUBLE_VALID;
+                parsedDouble = parsed;
+            }
+        }
+
+        if (!(parsedFlags & DOUBLE_VALID))
+            return false;
+
+        out = parsedDouble;
+        return true;
+    }
+
+    template<>
+    bool SoffitField::getValueAs<bool>(bool& out) {
+        if (!(parsedFlags & BOOL_PARSED)) {
+            bool parsed;
+            parsedFlags |= BOOL_PARSED;
+            if (_parseBool(value, parsed))
+                parsedFlags |= parsed ? BOOL_VALID | BOOL_VALUE : BOOL_VALID;
+        }
+
+        if (!(parsedFlags & BOOL_VALID))
+            return false;
+
+        out = (parsedFlags & BOOL_VALUE) != 0;
+        return true;
+    }
+
+    template<>
+    void SoffitField::setValueAs<int64_t>(int64_t v) {
+        value = _formatInteger(v);
+
+        //The value is known, so prime the cache instead of clearing it
+        parsedFlags = INTEGER_PARSED | INTEGER_VALID;
+        parsedInteger = v;
+
+        if (parent != nullptr)
+            parent->invalidateHash();
+    }
+
+    template<>
+    void SoffitField::setValueAs<int>(int v) {
+        setValueAs<int64_t>(v);
+    }
+
+    template<>
+    void SoffitField::setValueAs<double>(double v) {
+        value = _formatDouble(v);
+
+        parsedFlags = DOUBLE_PARSED | DOUBLE_VALID;
+        parsedDouble = v;
+
+        if (parent != nullptr)
+            parent->invalidateHash();
+    }
+
+    template<>
+    void SoffitField::setValueAs<bool>(bool v) {
+        value = v ? "true" : "false";
+
+        parsedFlags = v ? BOOL_PARSED | BOOL_VALID | BOOL_VALUE : BOOL_PARSED | BOOL_VALID;
+
+        if (parent != nullptr)
+            parent->invalidateHash();
     }
 
     void SoffitField::setParent(SoffitObject* p) {
         parent = p;
     }
+
+    void SoffitField::shrinkToFit() {
+        name.shrink_to_fit();
+        value.shrink_to_fit();
+    }
+
+    size_t SoffitField::memoryUsage() {
+        return sizeof(SoffitField) + _heapUsage(name) + _heapUsage(value);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,532 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace CPPSoffit {
+
+    static const char IMAGE_MAGIC[8] = { 'S', 'O', 'F', 'F', 'I', 'M', 'G', '\0' };
+    static const uint32_t IMAGE_VERSION = 1;
+    static const uint32_t IMAGE_BYTE_ORDER = 0x01020304;
+    static const uint64_t IMAGE_NONE = UINT64_MAX;
+
+    //Strings up to this length are stored once however often they occur, which covers types, names and the
+    //short values that repeat; longer values are rarely repeated, and are not worth the memory to look up
+    static const size_t IMAGE_SHARED_STRING = 64;
+
+    // Every section starts on an 8-byte boundary, and every record is a multiple of 8 bytes, so that a mapped
+    // image can be read in place.  The header records the byte order, and an image is only opened by a machine
+    // with the same one.
+    struct SoffitImage::String {
+        uint64_t offset;
+        uint64_t length;
+    };
+
+    struct SoffitImage::Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t size;
+        //_hashBytes of everything after the header
+        uint64_t checksum;
+        uint64_t objectCount;
+        uint64_t fieldCount;
+        uint64_t objects;
+        uint64_t fields;
+        //For each object, the positions of its children sorted by type and name, and of its fields sorted by
+        //name, stored in the same range as the children and fields themselves
+        uint64_t objectIndex;
+        uint64_t fieldIndex;
+        uint64_t strings;
+        uint64_t stringsSize;
+    };
+
+    //Objects are stored breadth first, so that the children of an object, and its fields, are contiguous
+    struct SoffitImage::Object {
+        String type;
+        String name;
+        uint64_t parent;
+        uint64_t firstChild;
+        uint64_t childCount;
+        uint64_t firstField;
+        uint64_t fieldCount;
+    };
+
+    struct SoffitImage::Field {
+        String name;
+        String value;
+    };
+
+    SoffitImage::SoffitImage(const char* data, size_t size) {
+        this->data = data;
+        this->size = size;
+    }
+
+    SoffitImage::~SoffitImage() {
+        if (mapping == nullptr)
+            return;
+
+#if defined(_WIN32)
+        UnmapViewOfFile(mapping);
+#else
+        munmap(mapping, mappingSize);
+#endif
+    }
+
+    SoffitImageObject SoffitImage::getRoot() const {
+        return SoffitImageObject(this, 0);
+    }
+
+    uint64_t SoffitImage::getObjectCount() const {
+        return header->objectCount;
+    }
+
+    uint64_t SoffitImage::getFieldCount() const {
+        return header->fieldCount;
+    }
+
+    bool SoffitImage::verify() const {
+        return _hashBytes(data + sizeof(Header), size - sizeof(Header)) == header->checksum;
+    }
+
+    const SoffitImage::Object& SoffitImage::object(uint64_t index) const {
+        if (index >= header->objectCount)
+            throw SoffitException("Corrupt SOFFIT image.");
+
+        return objects[index];
+    }
+
+    const SoffitImage::Field& SoffitImage::field(uint64_t index) const {
+        if (index >= header->fieldCount)
+            throw SoffitException("Corrupt SOFFIT image.");
+
+        return fields[index];
+    }
+
+    std::string_view SoffitImage::string(const String& s) const {
+        if (s.offset > header->stringsSize || s.length > header->stringsSize - s.offset)
+            throw SoffitException("Corrupt SOFFIT image.");
+
+        return std::string_view(strings + s.offset, s.length);
+    }
+
+    SoffitImageField::SoffitImageField(const SoffitImage* image, uint64_t index) {
+        this->image = image;
+        this->index = index;
+    }
+
+    std::string_view SoffitImageField::getName() const {
+        return image->string(image->field(index).name);
+    }
+
+    std::string_view SoffitImageField::getValue() const {
+        return image->string(image->field(index).value);
+    }
+
+    SoffitImageObject::SoffitImageObject(const SoffitImage* image, uint64_t index) {
+        this->image = image;
+        this->index = index;
+    }
+
+    std::string_view SoffitImageObject::getType() const {
+        return image->string(image->object(index).type);
+    }
+
+    std::string_view SoffitImageObject::getName() const {
+        return image->string(image->object(index).name);
+    }
+
+    bool SoffitImageObject::isRoot() const {
+        return image->object(index).parent == IMAGE_NONE;
+    }
+
+    //Breadth first order puts every parent before its children, which rules out cycles in a damaged image
+    SoffitImageObject SoffitImageObject::getParent() const {
+        uint64_t parent = image->object(index).parent;
+        if (parent >= index)
+            throw SoffitException("Corrupt SOFFIT image.");
+
+        return SoffitImageObject(image, parent);
+    }
+
+    size_t SoffitImageObject::getObjectCount() const {
+        return image->object(index).childCount;
+    }
+
+    size_t SoffitImageObject::getFieldCount() const {
+        return image->object(index).fieldCount;
+    }
+
+    SoffitImageObject SoffitImageObject::getObjectAt(size_t i) const {
+        const SoffitImage::Object& object = image->object(index);
+        if (i >= object.childCount)
+            throw SoffitException("SoffitImageObject child index out of range.");
+        if (object.firstChild <= index)
+            throw SoffitException("Corrupt SOFFIT image.");
+
+        return SoffitImageObject(image, object.firstChild + i);
+    }
+
+    SoffitImageField SoffitImageObject::getFieldAt(size_t i) const {
+        const SoffitImage::Object& object = image->object(index);
+        if (i >= object.fieldCount)
+            throw SoffitException("SoffitImageObject field index out of range.");
+
+        return SoffitImageField(image, object.firstField + i);
+    }
+
+    bool SoffitImageObject::getObjectByTypeAndName(std::string_view type, std::string_view name, SoffitImageObject& out) const {
+        const SoffitImage::Object& object = image->object(index);
+        if (object.firstChild > image->header->objectCount || object.childCount > image->header->objectCount - object.firstChild)
+            throw SoffitException("Corrupt SOFFIT image.");
+
+        //The index is sorted by type, then name, then position, so the first match is the first in document order
+        const uint64_t* begin = image->objectIndex + object.firstChild;
+        const uint64_t* end = begin + object.childCount;
+        const uint64_t* found = std::lower_bound(begin, end, 0, [&](uint64_t child, int) {
+            const SoffitImage::Object& o = image->object(child);
+            int order = image->string(o.type).compare(type);
+            if (order == 0)
+                order = image->string(o.name).compare(name);
+            return order < 0;
+        });
+
+        if (found == end)
+            return false;
+        if (*found < object.firstChild || *found - object.firstChild >= object.childCount || object.firstChild <= index)
+            throw SoffitException("Corrupt SOFFIT image.");
+
+        const SoffitImage::Object& match = image->object(*found);
+        if (image->string(match.type) != type || image->string(match.name) != name)
+            return false;
+
+        out = SoffitImageObject(image, *found);
+        return true;
+    }
+
+    bool SoffitImageObject::getField(std::string_view name, SoffitImageField& out) const {
+        const SoffitImage::Object& object = image->object(index);
+        if (object.firstField > image->header->fieldCount || object.fieldCount > image->header->fieldCount - object.firstField)
+            throw SoffitException("Corrupt SOFFIT image.");
+
+        const uint64_t* begin = image->fieldIndex + object.firstField;
+        const uint64_t* end = begin + object.fieldCount;
+        const uint64_t* found = std::lower_bound(begin, end, 0, [&](uint64_t f, int) {
+            return image->string(image->field(f).name) < name;
+        });
+
+        if (found == end || image->string(image->field(*found).name) != name)
+            return false;
+        if (*found < object.firstField || *found - object.firstField >= object.fieldCount)
+            throw SoffitException("Corrupt SOFFIT image.");
+
+        out = SoffitImageField(image, *found);
+        return true;
+    }
+
+    SoffitObject* SoffitImageObject::toObject() const {
+        SoffitObject* copy = new SoffitObject(std::string(getType()), std::string(getName()));
+
+        try {
+            for (size_t i = 0; i < getFieldCount(); i++) {
+                SoffitImageField field = getFieldAt(i);
+                copy->add(new SoffitField(std::string(field.getName()), std::string(field.getValue())));
+            }
+
+            for (size_t i = 0; i < getObjectCount(); i++)
+                copy->add(getObjectAt(i).toObject());
+        }
+        catch (...) {
+            delete copy;
+            throw;
+        }
+
+        return copy;
+    }
+
+    void SaveImage(SoffitObject* root, std::ostream& output) {
+        std::vector<SoffitImage::Object> objects;
+        std::vector<SoffitImage::Field> fields;
+        std::string strings;
+
+        //Shared strings are kept in an open addressing table of their places in the pool, so no keys are copied
+        std::vector<SoffitImage::String> shared(1024, SoffitImage::String{ 0, IMAGE_NONE });
+        size_t sharedCount = 0;
+
+        auto addString = [&](const std::string& s) {
+            SoffitImage::String result{ strings.size(), s.size() };
+            if (s.size() > IMAGE_SHARED_STRING) {
+                strings.append(s);
+                return result;
+            }
+
+            size_t mask = shared.size() - 1;
+            size_t slot = _hashString(s) & mask;
+            while (shared[slot].length != IMAGE_NONE) {
+                if (shared[slot].length == s.size() && strings.compare(shared[slot].offset, s.size(), s) == 0)
+                    return shared[slot];
+                slot = (slot + 1) & mask;
+            }
+
+            strings.append(s);
+            shared[slot] = result;
+
+            //Grow at half full, placing every string again from its bytes in the pool
+            if (++sharedCount * 2 > shared.size()) {
+                std::vector<SoffitImage::String> grown(shared.size() * 2, SoffitImage::String{ 0, IMAGE_NONE });
+                mask = grown.size() - 1;
+
+                for (size_t i = 0; i < shared.size(); i++) {
+                    if (shared[i].length == IMAGE_NONE)
+                        continue;
+
+                    slot = _hashBytes(strings.data() + shared[i].offset, shared[i].length) & mask;
+                    while (grown[slot].length != IMAGE_NONE)
+                        slot = (slot + 1) & mask;
+                    grown[slot] = shared[i];
+                }
+
+                shared.swap(grown);
+            }
+
+            return result;
+        };
+
+        //Lay the objects out breadth first, giving each its children's and fields' positions as it is reached
+        std::vector<SoffitObject*> order;
+        order.push_back(root);
+        objects.push_back({ addString(root->getType()), addString(root->getName()), IMAGE_NONE, 0, 0, 0, 0 });
+
+        for (size_t i = 0; i < order.size(); i++) {
+            std::vector<SoffitField*> objectFields = order[i]->getAllFields();
+            std::vector<SoffitObject*> children = order[i]->getAllObjects();
+
+            objects[i].firstField = fields.size();
+            objects[i].fieldCount = objectFields.size();
+            for (size_t j = 0; j < objectFields.size(); j++)
+                fields.push_back({ addString(objectFields[j]->getName()), addString(objectFields[j]->getValue()) });
+
+            objects[i].firstChild = order.size();
+            objects[i].childCount = children.size();
+            for (size_t j = 0; j < children.size(); j++) {
+                order.push_back(children[j]);
+                objects.push_back({ addString(children[j]->getType()), addString(children[j]->getName()), i, 0, 0, 0, 0 });
+            }
+        }
+
+        //Build the lookup indexes.  Stable sorts keep equal keys in document order
+        auto view = [&](const SoffitImage::String& s) {
+            return std::string_view(strings.data() + s.offset, s.length);
+        };
+
+        std::vector<uint64_t> objectIndex(objects.size());
+        std::vector<uint64_t> fieldIndex(fields.size());
+        for (size_t i = 0; i < objectIndex.size(); i++)
+            objectIndex[i] = i;
+        for (size_t i = 0; i < fieldIndex.size(); i++)
+            fieldIndex[i] = i;
+
+        for (size_t i = 0; i < objects.size(); i++) {
+            SoffitImage::Object& object = objects[i];
+
+            std::stable_sort(objectIndex.begin() + object.firstChild, objectIndex.begin() + object.firstChild + object.childCount, [&](uint64_t a, uint64_t b) {
+                int order = view(objects[a].type).compare(view(objects[b].type));
+                if (order == 0)
+                    order = view(objects[a].name).compare(view(objects[b].name));
+                return order < 0;
+            });
+
+            std::stable_sort(fieldIndex.begin() + object.firstField, fieldIndex.begin() + object.firstField + object.fieldCount, [&](uint64_t a, uint64_t b) {
+                return view(fields[a].name) < view(fields[b].name);
+            });
+        }
+
+        strings.resize((strings.size() + 7) & ~(size_t) 7, '\0');
+
+        SoffitImage::Header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+        header.version = IMAGE_VERSION;
+        header.byteOrder = IMAGE_BYTE_ORDER;
+        header.objectCount = objects.size();
+        header.fieldCount = fields.size();
+        header.objects = sizeof(SoffitImage::Header);
+        header.fields = header.objects + objects.size() * sizeof(SoffitImage::Object);
+        header.objectIndex = header.fields + fields.size() * sizeof(SoffitImage::Field);
+        header.fieldIndex = header.objectIndex + objectIndex.size() * sizeof(uint64_t);
+        header.strings = header.fieldIndex + fieldIndex.size() * sizeof(uint64_t);
+        header.stringsSize = strings.size();
+        header.size = header.strings + strings.size();
+
+        uint64_t checksum = _hashBytes((const char*) objects.data(), objects.size() * sizeof(SoffitImage::Object));
+        checksum = _hashBytes((const char*) fields.data(), fields.size() * sizeof(SoffitImage::Field), checksum);
+        checksum = _hashBytes((const char*) objectIndex.data(), objectIndex.size() * sizeof(uint64_t), checksum);
+        checksum = _hashBytes((const char*) fieldIndex.data(), fieldIndex.size() * sizeof(uint64_t), checksum);
+        header.checksum = _hashBytes(strings.data(), strings.size(), checksum);
+
+        output.write((const char*) &header, sizeof(header));
+        output.write((const char*) objects.data(), objects.size() * sizeof(SoffitImage::Object));
+        output.write((const char*) fields.data(), fields.size() * sizeof(SoffitImage::Field));
+        output.write((const char*) objectIndex.data(), objectIndex.size() * sizeof(uint64_t));
+        output.write((const char*) fieldIndex.data(), fieldIndex.size() * sizeof(uint64_t));
+        output.write(strings.data(), strings.size());
+    }
+
+    void SaveImage(SoffitObject* root, const std::string& path) {
+        std::ofstream output(path, std::ios::binary | std::ios::trunc);
+        if (!output)
+            throw SoffitException("Could not write SOFFIT image '" + path + "'.");
+
+        SaveImage(root, output);
+
+        output.flush();
+        if (!output)
+            throw SoffitException("Could not write SOFFIT image '" + path + "'.");
+    }
+
+    SoffitImage* LoadImageFromMemory(const char* data, size_t size, bool verifyChecksum) {
+        if (((uintptr_t) data & 7) != 0)
+            throw SoffitException("SOFFIT image is not 8-byte aligned.");
+        if (size < sizeof(SoffitImage::Header))
+            throw SoffitException("Not a SOFFIT image.");
+
+        const SoffitImage::Header* header = (const SoffitImage::Header*) data;
+        if (std::memcmp(header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0)
+            throw SoffitException("Not a SOFFIT image.");
+        if (header->version != IMAGE_VERSION)
+            throw SoffitException("Unsupported SOFFIT image version " + std::to_string(header->version) + ".");
+        if (header->byteOrder != IMAGE_BYTE_ORDER)
+            throw SoffitException("SOFFIT image was written with a different byte order.");
+
+        //The sections must follow one another in order, exactly filling the image, which also rules out
+        //counts large enough to overflow
+        uint64_t objectsSize = header->objectCount * sizeof(SoffitImage::Object);
+        uint64_t fieldsSize = header->fieldCount * sizeof(SoffitImage::Field);
+        bool valid = header->size == size
+            && header->objectCount > 0
+            && header->objectCount <= size / sizeof(SoffitImage::Object)
+            && header->fieldCount <= size / sizeof(SoffitImage::Field)
+            && header->objects == sizeof(SoffitImage::Header)
+            && header->fields == header->objects + objectsSize
+            && header->objectIndex == header->fields + fieldsSize
+            && header->fieldIndex == header->objectIndex + header->objectCount * sizeof(uint64_t)
+            && header->strings == header->fieldIndex + header->fieldCount * sizeof(uint64_t)
+            && header->strings <= size
+            && header->stringsSize == size - header->strings;
+        if (!valid)
+            throw SoffitException("Corrupt SOFFIT image.");
+
+        SoffitImage* image = new SoffitImage(data, size);
+        image->header = header;
+        image->objects = (const SoffitImage::Object*) (data + header->objects);
+        image->fields = (const SoffitImage::Field*) (data + header->fields);
+        image->objectIndex = (const uint64_t*) (data + header->objectIndex);
+        image->fieldIndex = (const uint64_t*) (data + header->fieldIndex);
+        image->strings = data + header->strings;
+
+        if (verifyChecksum && !image->verify()) {
+            delete image;
+            throw SoffitException("SOFFIT image checksum mismatch.");
+        }
+
+        return image;
+    }
+
+    SoffitImage* LoadImage(const std::string& path, bool verifyChecksum) {
+        void* mapping = nullptr;
+        size_t size = 0;
+
+#if defined(_WIN32)
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw SoffitException("Could not open SOFFIT image '" + path + "'.");
+
+        LARGE_INTEGER length;
+        HANDLE view = nullptr;
+        if (GetFileSizeEx(file, &length) && length.QuadPart > 0) {
+            size = (size_t) length.QuadPart;
+            view = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        }
+        if (view != nullptr) {
+            mapping = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(view);
+        }
+        CloseHandle(file);
+#else
+        int file = open(path.c_str(), O_RDONLY);
+        if (file < 0)
+            throw SoffitException("Could not open SOFFIT image '" + path + "'.");
+
+        struct stat info;
+        if (fstat(file, &info) == 0 && info.st_size > 0) {
+            size = (size_t) info.st_size;
+            mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+            if (mapping == MAP_FAILED)
+                mapping = nullptr;
+        }
+        close(file);
+#endif
+
+        if (mapping == nullptr)
+            throw SoffitException("Could not map SOFFIT image '" + path + "'.");
+
+        SoffitImage* image;
+        try {
+            image = LoadImageFromMemory((const char*) mapping, size, verifyChecksum);
+        }
+        catch (...) {
+#if defined(_WIN32)
+            UnmapViewOfFile(mapping);
+#else
+            munmap(mapping, size);
+#endif
+            throw;
+        }
+
+        image->mapping = mapping;
+        image->mappingSize = size;
+        return image;
+    }
+}
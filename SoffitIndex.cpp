@@ -0,0 +1,270 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+#include <algorithm>
+
+namespace CPPSoffit {
+
+    //Order keys are spread out when a document is indexed, so that objects added later can be numbered between them
+    static const uint64_t ORDER_SPACING = (uint64_t) 1 << 32;
+    //Added objects are numbered close together, so that repeated additions at one place use up the gap slowly
+    static const uint64_t INSERT_SPACING = (uint64_t) 1 << 16;
+
+    SoffitObjectRange::SoffitObjectRange() {
+    }
+
+    SoffitObjectRange::SoffitObjectRange(SoffitObject* const* first, SoffitObject* const* last) {
+        this->first = first;
+        this->last = last;
+    }
+
+    SoffitObject* const* SoffitObjectRange::begin() const {
+        return first;
+    }
+
+    SoffitObject* const* SoffitObjectRange::end() const {
+        return last;
+    }
+
+    size_t SoffitObjectRange::size() const {
+        return last - first;
+    }
+
+    bool SoffitObjectRange::empty() const {
+        return first == last;
+    }
+
+    SoffitObject* SoffitObjectRange::operator[](size_t i) const {
+        return first[i];
+    }
+
+    SoffitIndex::SoffitIndex(SoffitObject* root) {
+        this->root = root;
+
+        std::vector<SoffitObject*> nodes;
+        collect(root, nodes);
+
+        //Preorder is document order, so every list is built already sorted
+        for (size_t i = 0; i < nodes.size(); i++) {
+            nodes[i]->getExtras()->order = (i + 1) * ORDER_SPACING;
+            if (i == 0)
+                continue;
+
+            Bucket& bucket = types[nodes[i]->type];
+            bucket.objects.push_back(nodes[i]);
+            bucket.byName[nodes[i]->name].push_back(nodes[i]);
+        }
+    }
+
+    SoffitIndex* SoffitIndex::of(SoffitObject* object) {
+        SoffitObject* root = object;
+        while (root->parent != nullptr)
+            root = root->parent;
+
+        SoffitObject::Extras* extras = root->getExtras();
+        if (extras->index == nullptr)
+            extras->index = new SoffitIndex(root);
+
+        return extras->index;
+    }
+
+    SoffitObjectRange SoffitIndex::find(SoffitObject* within, const std::string& type) {
+        std::unordered_map<std::string, Bucket>::iterator bucket = types.find(type);
+        if (bucket == types.end())
+            return SoffitObjectRange();
+
+        return range(bucket->second.objects, within);
+    }
+
+    SoffitObjectRange SoffitIndex::find(SoffitObject* within, const std::string& type, const std::string& name) {
+        std::unordered_map<std::string, Bucket>::iterator bucket = types.find(type);
+        if (bucket == types.end())
+            return SoffitObjectRange();
+
+        std::unordered_map<std::string, std::vector<SoffitObject*>>::iterator named = bucket->second.byName.find(name);
+        if (named == bucket->second.byName.end())
+            return SoffitObjectRange();
+
+        return range(named->second, within);
+    }
+
+    void SoffitIndex::insertSubtree(SoffitObject* object) {
+        SoffitObject* parent = object->parent;
+
+        //The new objects go after everything already beneath the parent, and before whatever follows the parent
+        uint64_t low = parent->extras->order;
+        if (parent->objects.size() > 1)
+            low = lastDescendant(parent->objects[parent->objects.size() - 2])->extras->order;
+
+        uint64_t high = UINT64_MAX;
+        for (SoffitObject* ancestor = parent; ancestor->parent != nullptr; ancestor = ancestor->parent) {
+            std::vector<SoffitObject*>& siblings = ancestor->parent->objects;
+            std::vector<SoffitObject*>::iterator next = std::upper_bound(siblings.begin(), siblings.end(), ancestor->extras->order, after);
+            if (next != siblings.end()) {
+                high = (*next)->extras->order;
+                break;
+            }
+        }
+
+        std::vector<SoffitObject*> nodes;
+        collect(object, nodes);
+
+        uint64_t step = std::min((high - low) / (nodes.size() + 1), INSERT_SPACING);
+        if (step == 0) {
+            renumber();
+        }
+        else {
+            for (size_t i = 0; i < nodes.size(); i++)
+                nodes[i]->getExtras()->order = low + step * (i + 1);
+        }
+
+        //The new objects are adjacent in document order, so each list takes them as one run
+        std::unordered_map<std::vector<SoffitObject*>*, std::vector<SoffitObject*>> runs;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            Bucket& bucket = types[nodes[i]->type];
+            runs[&bucket.objects].push_back(nodes[i]);
+            runs[&bucket.byName[nodes[i]->name]].push_back(nodes[i]);
+        }
+
+        for (std::unordered_map<std::vector<SoffitObject*>*, std::vector<SoffitObject*>>::iterator run = runs.begin(); run != runs.end(); run++) {
+            std::vector<SoffitObject*>& objects = *run->first;
+            std::vector<SoffitObject*>::iterator position = std::upper_bound(objects.begin(), objects.end(), run->second.front()->extras->order, after);
+            objects.insert(position, run->second.begin(), run->second.end());
+        }
+    }
+
+    void SoffitIndex::removeSubtree(SoffitObject* object) {
+        removeRange(object, object->extras->order, lastDescendant(object)->extras->order, true);
+    }
+
+    void SoffitIndex::addNode(SoffitObject* object) {
+        Bucket& bucket = types[object->type];
+        bucket.objects.insert(std::upper_bound(bucket.objects.begin(), bucket.objects.end(), object->extras->order, after), object);
+
+        std::vector<SoffitObject*>& named = bucket.byName[object->name];
+        named.insert(std::upper_bound(named.begin(), named.end(), object->extras->order, after), object);
+    }
+
+    void SoffitIndex::removeNode(SoffitObject* object) {
+        removeRange(object, object->extras->order, object->extras->order, false);
+    }
+
+    size_t SoffitIndex::memoryUsage() {
+        size_t bytes = sizeof(SoffitIndex);
+
+        for (std::unordered_map<std::string, Bucket>::iterator bucket = types.begin(); bucket != types.end(); bucket++) {
+            bytes += sizeof(Bucket) + _heapUsage(bucket->first) + bucket->second.objects.capacity() * sizeof(SoffitObject*);
+
+            std::unordered_map<std::string, std::vector<SoffitObject*>>& byName = bucket->second.byName;
+            for (std::unordered_map<std::string, std::vector<SoffitObject*>>::iterator named = byName.begin(); named != byName.end(); named++)
+                bytes += sizeof(*named) + _heapUsage(named->first) + named->second.capacity() * sizeof(SoffitObject*);
+        }
+
+        return bytes;
+    }
+
+    bool SoffitIndex::before(const SoffitObject* object, uint64_t order) {
+        return object->extras->order < order;
+    }
+
+    bool SoffitIndex::after(uint64_t order, const SoffitObject* object) {
+        return order < object->extras->order;
+    }
+
+    SoffitObject* SoffitIndex::lastDescendant(SoffitObject* object) {
+        while (!object->objects.empty())
+            object = object->objects.back();
+
+        return object;
+    }
+
+    //The objects beneath within are those numbered after it, up to and including its last descendant
+    SoffitObjectRange SoffitIndex::range(const std::vector<SoffitObject*>& objects, SoffitObject* within) {
+        std::vector<SoffitObject*>::const_iterator first = std::upper_bound(objects.begin(), objects.end(), within->extras->order, after);
+        std::vector<SoffitObject*>::const_iterator last = std::upper_bound(first, objects.end(), lastDescendant(within)->extras->order, after);
+
+        return SoffitObjectRange(objects.data() + (first - objects.begin()), objects.data() + (last - objects.begin()));
+    }
+
+    void SoffitIndex::eraseRange(std::vector<SoffitObject*>& objects, uint64_t low, uint64_t high) {
+        std::vector<SoffitObject*>::iterator first = std::lower_bound(objects.begin(), objects.end(), low, before);
+        std::vector<SoffitObject*>::iterator last = std::upper_bound(first, objects.end(), high, after);
+        objects.erase(first, last);
+    }
+
+    // Lists object and its descendants in document order, clearing their order keys and parsing any lazy bodies,
+    // so that the objects the parse adds do not try to index themselves
+    void SoffitIndex::collect(SoffitObject* object, std::vector<SoffitObject*>& nodes) {
+        if (object->extras != nullptr)
+            object->extras->order = 0;
+        if (!object->isBodyParsed())
+            object->parseLazyBody();
+
+        nodes.push_back(object);
+        for (size_t i = 0; i < object->objects.size(); i++)
+            collect(object->objects[i], nodes);
+    }
+
+    //Renumbering keeps the relative order of every object, so the lists stay sorted
+    void SoffitIndex::renumber() {
+        std::vector<SoffitObject*> nodes;
+        collect(root, nodes);
+
+        for (size_t i = 0; i < nodes.size(); i++)
+            nodes[i]->getExtras()->order = (i + 1) * ORDER_SPACING;
+    }
+
+    // Erases the run of keys from low to high from the lists of object and, if recursive, of its descendants.
+    // Each list holds the whole run together, so erasing it again for a later object is a no-op.
+    void SoffitIndex::removeRange(SoffitObject* object, uint64_t low, uint64_t high, bool recursive) {
+        std::unordered_map<std::string, Bucket>::iterator bucket = types.find(object->type);
+        if (bucket != types.end()) {
+            eraseRange(bucket->second.objects, low, high);
+
+            std::unordered_map<std::string, std::vector<SoffitObject*>>::iterator named = bucket->second.byName.find(object->name);
+            if (named != bucket->second.byName.end()) {
+                eraseRange(named->second, low, high);
+                if (named->second.empty())
+                    bucket->second.byName.erase(named);
+            }
+
+            if (bucket->second.objects.empty())
+                types.erase(bucket);
+        }
+
+        if (!recursive)
+            return;
+
+        for (size_t i = 0; i < object->objects.size(); i++)
+            removeRange(object->objects[i], low, high, true);
+    }
+}
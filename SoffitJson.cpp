@@ -0,0 +1,700 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+
+namespace CPPSoffit {
+    // Write the contents of a JSON string, escaping quotes, backslashes and control characters
+    static void _writeJsonEscaped(std::ostream& output, const char* p, const char* end) {
+        static const char* hex = "0123456789abcdef";
+
+        while (p < end) {
+            const char* run = p;
+            while (p < end && *p != '"' && *p != '\\' && (unsigned char) *p >= 0x20)
+                p++;
+            output.write(run, p - run);
+
+            if (p == end)
+                break;
+
+            switch (*p) {
+            case '"': output << "\\\""; break;
+            case '\\': output << "\\\\"; break;
+            case '\n': output << "\\n"; break;
+            case '\r': output << "\\r"; break;
+            case '\t': output << "\\t"; break;
+            case '\b': output << "\\b"; break;
+            case '\f': output << "\\f"; break;
+            default:
+                output << "\\u00";
+                output.put(hex[(unsigned char) *p >> 4]);
+                output.put(hex[*p & 0xF]);
+            }
+            p++;
+        }
+    }
+
+    static void _writeJsonString(std::ostream& output, const std::string& s) {
+        output.put('"');
+        _writeJsonEscaped(output, s.data(), s.data() + s.size());
+        output.put('"');
+    }
+
+    SoffitJsonWriter::SoffitJsonWriter(std::ostream& output, bool indent) {
+        this->output = &output;
+        this->indent = indent;
+    }
+
+    // Open the root JSON object on the first event of each document
+    void SoffitJsonWriter::begin() {
+        if (started)
+            return;
+
+        if (levels.empty())
+            levels.emplace_back();
+        levels[0].run = None;
+        levels[0].first = true;
+        depth = 0;
+
+        output->put('{');
+        started = true;
+    }
+
+    void SoffitJsonWriter::newLine(size_t indentation) {
+        if (!indent)
+            return;
+
+        output->put('\n');
+        for (size_t i = 0; i < indentation; i++)
+            output->put('\t');
+    }
+
+    // Start a member of the innermost JSON object.  Its members are indented two steps per object, one for the object and one for its array
+    void SoffitJsonWriter::writeKey(Level& level, const std::string& key) {
+        if (!level.first)
+            output->put(',');
+        level.first = false;
+
+        newLine(2 * depth + 1);
+        _writeJsonString(*output, key);
+        *output << (indent ? ": " : ":");
+    }
+
+    void SoffitJsonWriter::writeValue(const std::string& value) {
+        if (value.empty())
+            *output << "null";
+        else
+            _writeJsonString(*output, value);
+    }
+
+    // Finish the run of fields or objects sharing a key in the innermost JSON object, writing the buffered field value if there is one
+    void SoffitJsonWriter::closeRun() {
+        Level& level = levels[depth];
+
+        if (level.run == Fields) {
+            if (level.array) {
+                if (level.hasPending) {
+                    output->put(',');
+                    newLine(2 * depth + 2);
+                    writeValue(level.pending);
+                }
+                newLine(2 * depth + 1);
+                output->put(']');
+            }
+            else {
+                writeKey(level, level.key);
+                writeValue(level.pending);
+            }
+        }
+        else if (level.run == Objects) {
+            newLine(2 * depth + 1);
+            output->put(']');
+        }
+
+        level.run = None;
+        level.hasPending = false;
+    }
+
+    void SoffitJsonWriter::startObject(const std::string& type, const std::string& name, int lineNumber) {
+        if (type == SOFFIT_JSON_NAME)
+            throw SoffitException(SOFFIT_JSON_NAME + " is reserved, and can not be converted to JSON.", lineNumber);
+
+        begin();
+
+        Level& level = levels[depth];
+        if (level.run == Objects && level.key == type) {
+            output->put(',');
+        }
+        else {
+            closeRun();
+            writeKey(level, type);
+            output->put('[');
+            level.run = Objects;
+            level.key = type;
+        }
+        newLine(2 * depth + 2);
+        output->put('{');
+
+        depth++;
+        if (levels.size() == depth)
+            levels.emplace_back();
+
+        Level& child = levels[depth];
+        child.run = None;
+        child.first = true;
+
+        if (!name.empty()) {
+            writeKey(child, SOFFIT_JSON_NAME);
+            _writeJsonString(*output, name);
+        }
+    }
+
+    void SoffitJsonWriter::endObject(int lineNumber) {
+        if (!started || depth == 0)
+            throw SoffitException("Too many closing brackets.", lineNumber);
+
+        closeRun();
+        if (!levels[depth].first)
+            newLine(2 * depth);
+        output->put('}');
+
+        depth--;
+    }
+
+    void SoffitJsonWriter::field(const std::string& name, const std::string& value, int lineNumber) {
+        if (name == SOFFIT_JSON_NAME)
+            throw SoffitException(SOFFIT_JSON_NAME + " is reserved, and can not be converted to JSON.", lineNumber);
+
+        begin();
+
+        //The value is held back until the next event, which decides whether it is alone or part of an array
+        Level& level = levels[depth];
+        if (level.run == Fields && level.key == name) {
+            writeElement(level);
+        }
+        else {
+            closeRun();
+            level.run = Fields;
+            level.key = name;
+            level.array = false;
+        }
+
+        level.pending = value;
+        level.hasPending = true;
+    }
+
+    // Write the held back value as the next element of its run's array, opening the array if needed
+    void SoffitJsonWriter::writeElement(Level& level) {
+        if (!level.array) {
+            writeKey(level, level.key);
+            output->put('[');
+            level.array = true;
+        }
+        else if (level.hasPending) {
+            output->put(',');
+        }
+        else {
+            return;
+        }
+
+        newLine(2 * depth + 2);
+        writeValue(level.pending);
+        level.hasPending = false;
+    }
+
+    void SoffitJsonWriter::startField(const std::string& name, int lineNumber) {
+        if (name == SOFFIT_JSON_NAME)
+            throw SoffitException(SOFFIT_JSON_NAME + " is reserved, and can not be converted to JSON.", lineNumber);
+
+        begin();
+
+        //A streamed value can not be held back, so it joins a run of the same name as its last element,
+        //or is written alone and ends the run
+        Level& level = levels[depth];
+        if (level.run == Fields && level.key == name) {
+            writeElement(level);
+            output->put(',');
+            newLine(2 * depth + 2);
+        }
+        else {
+            closeRun();
+            writeKey(level, name);
+        }
+
+        output->put('"');
+    }
+
+    void SoffitJsonWriter::fieldChunk(const char* data, size_t length) {
+        _writeJsonEscaped(*output, data, data + length);
+    }
+
+    void SoffitJsonWriter::endField(int /*lineNumber*/) {
+        output->put('"');
+    }
+
+    void SoffitJsonWriter::endDocument(int /*lineNumber*/) {
+        begin();
+
+        closeRun();
+        if (!levels[0].first)
+            newLine(0);
+        *output << "}\n";
+
+        started = false;
+    }
+
+    void SoffitToJson(std::istream& input, std::ostream& output, bool indent, size_t chunkThreshold) {
+        SoffitJsonWriter writer(output, indent);
+        SoffitPushParser parser(&writer);
+        parser.setChunkThreshold(chunkThreshold);
+        std::vector<char> buffer(64 * 1024);
+
+        //Read a line, or a piece of a long one, at a time, so that nothing after the footer's line is taken from the input
+        while (!parser.isComplete()) {
+            input.getline(buffer.data(), (std::streamsize) buffer.size() - 1);
+            size_t length = (size_t) input.gcount();
+
+            if (input.eof()) {
+                parser.feed(buffer.data(), length);
+                break;
+            }
+
+            if (input.fail()) {
+                //The buffer filled before the end of the line
+                input.clear();
+                parser.feed(buffer.data(), length);
+            }
+            else {
+                //gcount includes the line terminator, which getline does not store
+                buffer[length - 1] = '\n';
+                parser.feed(buffer.data(), length);
+            }
+        }
+
+        parser.finish();
+    }
+
+    // A buffered reader over JSON input, tracking the line number for error messages
+    class JsonReader {
+    private:
+        std::istream& stream;
+        std::vector<char> buffer;
+        size_t begin = 0;
+        size_t end = 0;
+
+        bool fill() {
+            begin = 0;
+            end = 0;
+            if (!stream)
+                return false;
+
+            stream.read(buffer.data(), (std::streamsize) buffer.size());
+            end = (size_t) stream.gcount();
+            return end > 0;
+        }
+
+        int hexDigit() {
+            int c = get();
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F')
+                return c - 'A' + 10;
+            fail("Invalid unicode escape sequence.");
+        }
+
+        uint32_t codeUnit() {
+            uint32_t unit = 0;
+            for (int i = 0; i < 4; i++)
+                unit = (unit << 4) | (uint32_t) hexDigit();
+            return unit;
+        }
+
+        void appendUtf8(std::string& out, uint32_t c) {
+            if (c < 0x80) {
+                out.push_back((char) c);
+            }
+            else if (c < 0x800) {
+                out.push_back((char) (0xC0 | (c >> 6)));
+                out.push_back((char) (0x80 | (c & 0x3F)));
+            }
+            else if (c < 0x10000) {
+                out.push_back((char) (0xE0 | (c >> 12)));
+                out.push_back((char) (0x80 | ((c >> 6) & 0x3F)));
+                out.push_back((char) (0x80 | (c & 0x3F)));
+            }
+            else {
+                out.push_back((char) (0xF0 | (c >> 18)));
+                out.push_back((char) (0x80 | ((c >> 12) & 0x3F)));
+                out.push_back((char) (0x80 | ((c >> 6) & 0x3F)));
+                out.push_back((char) (0x80 | (c & 0x3F)));
+            }
+        }
+
+        void take(std::string& out) {
+            out.push_back((char) get());
+        }
+
+        void takeDigits(std::string& out) {
+            int c = peek();
+            if (c < '0' || c > '9')
+                fail("Invalid number.");
+
+            while (c >= '0' && c <= '9') {
+                take(out);
+                c = peek();
+            }
+        }
+
+    public:
+        int lineNumber = 1;
+
+        JsonReader(std::istream& stream) : stream(stream) {
+            buffer.resize(64 * 1024);
+        }
+
+        [[noreturn]] void fail(const std::string& message) {
+            throw SoffitException("JSON input, line " + std::to_string(lineNumber) + ": " + message);
+        }
+
+        int peek() {
+            if (begin == end && !fill())
+                return -1;
+            return (unsigned char) buffer[begin];
+        }
+
+        int get() {
+            int c = peek();
+            if (c != -1) {
+                begin++;
+                if (c == '\n')
+                    lineNumber++;
+            }
+            return c;
+        }
+
+        // Skip whitespace and return the next character without consuming it, or -1 at the end of the input
+        int skipWhitespace() {
+            while (true) {
+                int c = peek();
+                if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+                    return c;
+                get();
+            }
+        }
+
+        void expect(char c) {
+            if (get() != c)
+                fail(std::string("Expected '") + c + "'.");
+        }
+
+        void readLiteral(const char* word) {
+            for (const char* p = word; *p != '\0'; p++) {
+                if (get() != *p)
+                    fail("Invalid literal.");
+            }
+        }
+
+        // Read a number following the JSON grammar, keeping its text as written
+        void readNumber(std::string& out) {
+            out.clear();
+            if (peek() == '-')
+                take(out);
+
+            if (peek() == '0')
+                take(out);
+            else
+                takeDigits(out);
+
+            if (peek() == '.') {
+                take(out);
+                takeDigits(out);
+            }
+
+            if (peek() == 'e' || peek() == 'E') {
+                take(out);
+                if (peek() == '+' || peek() == '-')
+                    take(out);
+                takeDigits(out);
+            }
+        }
+
+        // Read a quoted string into out, decoding escape sequences.  Runs without escapes are copied straight from the buffer
+        void readString(std::string& out) {
+            expect('"');
+            out.clear();
+
+            while (true) {
+                if (begin == end && !fill())
+                    fail("Unterminated string.");
+
+                const char* run = buffer.data() + begin;
+                const char* runEnd = buffer.data() + end;
+                const char* p = run;
+                while (p < runEnd && *p != '"' && *p != '\\' && (unsigned char) *p >= 0x20)
+                    p++;
+                out.append(run, p - run);
+                begin += p - run;
+
+                if (p == runEnd)
+                    continue;
+
+                int c = get();
+                if (c == '"')
+                    return;
+                if (c != '\\')
+                    fail("Control character in string.");
+
+                switch (get()) {
+                case '"': out.push_back('"'); break;
+                case '\\': out.push_back('\\'); break;
+                case '/': out.push_back('/'); break;
+                case 'n': out.push_back('\n'); break;
+                case 'r': out.push_back('\r'); break;
+                case 't': out.push_back('\t'); break;
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'u': {
+                    uint32_t unit = codeUnit();
+                    if (unit >= 0xDC00 && unit <= 0xDFFF)
+                        fail("Invalid unicode escape sequence.");
+
+                    //A high surrogate must be followed by a low surrogate, together giving one code point
+                    if (unit >= 0xD800 && unit <= 0xDBFF) {
+                        if (get() != '\\' || get() != 'u')
+                            fail("Invalid unicode escape sequence.");
+                        uint32_t low = codeUnit();
+                        if (low < 0xDC00 || low > 0xDFFF)
+                            fail("Invalid unicode escape sequence.");
+                        unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                    }
+
+                    appendUtf8(out, unit);
+                    break;
+                }
+                default:
+                    fail("Invalid escape sequence.");
+                }
+            }
+        }
+    };
+
+    // An open JSON object or array.  Frames are never removed, so their keys' buffers are reused
+    struct JsonFrame {
+        bool array = false;
+        bool first = true;
+        bool headerPending = false;
+        std::string key;
+    };
+
+    // Check that a JSON key can be written as an object type or field name, and read back unchanged
+    static bool _isSoffitName(const std::string& key) {
+        if (key.empty() || key[0] == '#' || key == "}" || key == SOFFIT_END)
+            return false;
+
+        for (size_t i = 0; i < key.size(); i++) {
+            if (key[i] == ' ' || key[i] == '"' || (unsigned char) key[i] < 0x20)
+                return false;
+        }
+
+        return true;
+    }
+
+    static void _writeIndent(std::ostream& output, bool indent, int nestingLevel) {
+        if (indent) {
+            for (int i = 0; i < nestingLevel; i++)
+                output.put('\t');
+        }
+    }
+
+    void JsonToSoffit(std::istream& input, std::ostream& output, bool indent) {
+        JsonReader reader(input);
+        std::vector<JsonFrame> frames;
+        std::string key;
+        std::string value;
+        bool found = false;
+
+        // Write a field into the innermost open object
+        auto writeField = [&](const std::string& name, const std::string& fieldValue, int nestingLevel) {
+            _writeIndent(output, indent, nestingLevel + 1);
+            output << name;
+            if (!fieldValue.empty()) {
+                output << " \"";
+                _writeEscaped(output, fieldValue);
+                output << "\"";
+            }
+            output << "\n";
+        };
+
+        // Write the header line of an object, once its name is known
+        auto writeHeader = [&](const std::string& type, const std::string& name, int nestingLevel) {
+            _writeIndent(output, indent, nestingLevel);
+            output << type;
+            if (!name.empty()) {
+                output << " \"";
+                _writeEscaped(output, name);
+                output << "\"";
+            }
+            output << " {\n";
+        };
+
+        while (reader.skipWhitespace() != -1) {
+            if (reader.peek() != '{')
+                reader.fail("Expected a JSON object.");
+            reader.get();
+            found = true;
+
+            output << SOFFIT_START << "\n";
+
+            if (frames.empty())
+                frames.emplace_back();
+            frames[0].array = false;
+            frames[0].first = true;
+            frames[0].headerPending = false;
+
+            size_t depth = 1;
+            int nestingLevel = 0;
+
+            while (depth > 0) {
+                JsonFrame& frame = frames[depth - 1];
+                int c = reader.skipWhitespace();
+
+                //Check for the end of the object or array, or the separator before the next member
+                if (c == (frame.array ? ']' : '}')) {
+                    reader.get();
+
+                    if (!frame.array) {
+                        if (frame.headerPending)
+                            writeHeader(frame.key, "", nestingLevel);
+
+                        if (depth > 1) {
+                            _writeIndent(output, indent, nestingLevel);
+                            output << "}\n";
+                            nestingLevel--;
+                        }
+                    }
+
+                    depth--;
+                    continue;
+                }
+
+                if (!frame.first) {
+                    if (c != ',')
+                        reader.fail(std::string("Expected ',' or '") + (frame.array ? ']' : '}') + "'.");
+                    reader.get();
+                    c = reader.skipWhitespace();
+                }
+                frame.first = false;
+
+                if (frame.array) {
+                    if (c == '[')
+                        reader.fail("Nested arrays can not be converted to SOFFIT.");
+                    key = frame.key;
+                }
+                else {
+                    if (c != '"')
+                        reader.fail("Expected a key.");
+                    reader.readString(key);
+                    reader.skipWhitespace();
+                    reader.expect(':');
+                    c = reader.skipWhitespace();
+
+                    //A string first member keyed by SOFFIT_JSON_NAME is the object's name, rather than a field
+                    if (frame.headerPending) {
+                        frame.headerPending = false;
+
+                        if (key == SOFFIT_JSON_NAME && c == '"') {
+                            reader.readString(value);
+                            if (value.find('\r') != std::string::npos)
+                                reader.fail("Carriage returns can not be represented in SOFFIT.");
+                            writeHeader(frame.key, value, nestingLevel);
+                            continue;
+                        }
+
+                        writeHeader(frame.key, "", nestingLevel);
+                    }
+
+                    if (key == SOFFIT_JSON_NAME)
+                        reader.fail(SOFFIT_JSON_NAME + " must be the first member of an object, and hold a string.");
+                    if (!_isSoffitName(key))
+                        reader.fail("Key \"" + key + "\" is not a valid SOFFIT name.");
+                }
+
+                //frame may be invalidated from here on, as a new frame may be added
+                if (c == '{' || c == '[') {
+                    reader.get();
+
+                    if (frames.size() == depth)
+                        frames.emplace_back();
+                    JsonFrame& child = frames[depth++];
+                    child.array = c == '[';
+                    child.first = true;
+                    child.headerPending = c == '{';
+                    child.key = key;
+
+                    if (c == '{')
+                        nestingLevel++;
+                }
+                else if (c == '"') {
+                    reader.readString(value);
+                    if (value.find('\r') != std::string::npos)
+                        reader.fail("Carriage returns can not be represented in SOFFIT.");
+                    writeField(key, value, nestingLevel);
+                }
+                else if (c == 'n') {
+                    reader.readLiteral("null");
+                    writeField(key, "", nestingLevel);
+                }
+                else if (c == 't') {
+                    reader.readLiteral("true");
+                    writeField(key, "true", nestingLevel);
+                }
+                else if (c == 'f') {
+                    reader.readLiteral("false");
+                    writeField(key, "false", nestingLevel);
+                }
+                else if (c == '-' || (c >= '0' && c <= '9')) {
+                    reader.readNumber(value);
+                    writeField(key, value, nestingLevel);
+                }
+                else {
+                    reader.fail("Expected a value.");
+                }
+            }
+
+            output << SOFFIT_END << "\n";
+        }
+
+        if (!found)
+            reader.fail("Expected a JSON object.");
+    }
+}
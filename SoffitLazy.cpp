@@ -0,0 +1,158 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+#include <sstream>
+
+namespace CPPSoffit {
+
+    SoffitObject* ReadStreamLazy(std::istream& stream) {
+        int lineNumber = 0;
+
+        std::string header = _getLine(stream, lineNumber);
+        if (header != SOFFIT_START)
+            throw SoffitException("SOFFIT header not found.");
+
+        //Retain everything up to and including the footer
+        std::shared_ptr<std::string> source = std::make_shared<std::string>();
+        std::string line;
+        while (std::getline(stream, line)) {
+            source->append(line);
+            source->append(1, '\n');
+
+            size_t start = line.find_first_not_of(" \t");
+            if (start != std::string::npos && line.compare(start, SOFFIT_END.size(), SOFFIT_END) == 0) {
+                size_t rest = line.find_first_not_of(" \t\r", start + SOFFIT_END.size());
+                if (rest == std::string::npos || line[start + SOFFIT_END.size()] == ' ')
+                    break;
+            }
+        }
+
+        SoffitObject* root = new SoffitObject("", "");
+        try {
+            _parseLazyBody(root, source, 0, source->size(), lineNumber, true);
+        }
+        catch (...) {
+            delete root;
+            throw;
+        }
+
+        return root;
+    }
+
+    SoffitObject* ReadStreamFromStringLazy(std::string& stream) {
+        std::istringstream iss(stream);
+        return ReadStreamLazy(iss);
+    }
+
+    //************************************************
+    //*********BEGIN INTERNAL IMPLEMENTATION**********
+    //************************************************
+
+    // Parse the fields of an object, and create its child objects with their bodies left unparsed
+    void _parseLazyBody(SoffitObject* object, const std::shared_ptr<const std::string>& source, size_t begin, size_t end, int lineNumber, bool isRoot) {
+        const char* data = source->data();
+        size_t pos = begin;
+        size_t lineBegin;
+        size_t lineEnd;
+
+        while (true) {
+            if (!_nextLine(data, pos, end, lineNumber, lineBegin, lineEnd)) {
+                if (isRoot)
+                    throw SoffitException("Incomplete SOFFIT stream.");
+                return;
+            }
+
+            SoffitLineKind kind = _classifyLine(data + lineBegin, data + lineEnd);
+
+            if (kind == SoffitLineKind::Close) {
+                //The closing bracket of a non-root object lies outside of its body
+                throw SoffitException("Too many closing brackets.", lineNumber);
+            }
+            else if (kind == SoffitLineKind::Footer) {
+                if (!isRoot)
+                    throw SoffitException("SOFFIT footer encountered in non-root object.", lineNumber);
+                return;
+            }
+            else if (kind == SoffitLineKind::Object) {
+                std::string line(data + lineBegin, lineEnd - lineBegin);
+                std::vector<std::string> tokens = _getLineTokens(line, lineNumber);
+
+                SoffitObject* newObject;
+                if (tokens.size() == 2) {
+                    newObject = new SoffitObject(tokens[0]);
+                }
+                else {
+                    std::string objName = _stripQuotations(tokens[1]);
+                    _convertFromEscapeSequenceInPlace(objName, lineNumber);
+                    newObject = new SoffitObject(tokens[0], objName);
+                }
+                object->add(newObject);
+
+                //Skip to the matching closing bracket, counting brackets without building anything
+                size_t bodyBegin = pos;
+                int bodyLineNumber = lineNumber;
+                int depth = 1;
+
+                while (depth > 0) {
+                    if (!_nextLine(data, pos, end, lineNumber, lineBegin, lineEnd))
+                        throw SoffitException("Incomplete SOFFIT stream.");
+
+                    SoffitLineKind skipped = _classifyLine(data + lineBegin, data + lineEnd);
+                    if (skipped == SoffitLineKind::Close)
+                        depth--;
+                    else if (skipped == SoffitLineKind::Object)
+                        depth++;
+                    else if (skipped == SoffitLineKind::Footer)
+                        throw SoffitException("SOFFIT footer encountered in non-root object.", lineNumber);
+                    else if (skipped == SoffitLineKind::Invalid)
+                        throw SoffitException("SOFFIT syntax error.", lineNumber);
+                }
+
+                newObject->setLazyBody(source, bodyBegin, lineBegin, bodyLineNumber);
+            }
+            else if (kind == SoffitLineKind::Field) {
+                std::string line(data + lineBegin, lineEnd - lineBegin);
+                std::vector<std::string> tokens = _getLineTokens(line, lineNumber);
+
+                std::string fieldValue = "";
+                if (tokens.size() > 1)
+                    fieldValue = _stripQuotations(tokens[1]);
+
+                _convertFromEscapeSequenceInPlace(fieldValue, lineNumber);
+                object->add(new SoffitField(tokens[0], fieldValue));
+            }
+            else {
+                throw SoffitException("SOFFIT syntax error.", lineNumber);
+            }
+        }
+    }
+}
@@ -0,0 +1,143 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+
+namespace CPPSoffit {
+
+    void Merge(SoffitObject* base, SoffitObject* overlay, SoffitMergePolicy policy) {
+        //dropIndex walks up to the root, so it is done once per tree rather than at every level
+        base->dropIndex();
+        overlay->dropIndex();
+        _mergeObjects(base, overlay, policy);
+    }
+
+    //************************************************
+    //*********BEGIN INTERNAL IMPLEMENTATION**********
+    //************************************************
+
+    // Removes the flagged entries from a sibling vector in a single pass, deleting them
+    template<typename T>
+    static void _compactSiblings(std::vector<T*>& siblings, const std::vector<bool>& removed) {
+        size_t kept = 0;
+        for (size_t i = 0; i < siblings.size(); i++) {
+            if (i < removed.size() && removed[i])
+                delete siblings[i];
+            else
+                siblings[kept++] = siblings[i];
+        }
+        siblings.resize(kept);
+    }
+
+    void _mergeObjects(SoffitObject* base, SoffitObject* overlay, SoffitMergePolicy policy) {
+        if (!base->isBodyParsed())
+            base->parseLazyBody();
+        if (!overlay->isBodyParsed())
+            overlay->parseLazyBody();
+        base->invalidateHash();
+
+        //Fields.  Whatever is not moved into the base stays in the overlay, to be deleted with it
+        std::vector<SoffitField*> leftFields;
+        if (policy == SoffitMergePolicy::Append) {
+            for (size_t j = 0; j < overlay->fields.size(); j++) {
+                overlay->fields[j]->setParent(base);
+                base->fields.push_back(overlay->fields[j]);
+            }
+        }
+        else {
+            std::vector<std::string> baseKeys;
+            std::vector<std::string> overlayKeys;
+            baseKeys.reserve(base->fields.size());
+            overlayKeys.reserve(overlay->fields.size());
+            for (size_t i = 0; i < base->fields.size(); i++)
+                baseKeys.push_back(base->fields[i]->getName());
+            for (size_t j = 0; j < overlay->fields.size(); j++)
+                overlayKeys.push_back(overlay->fields[j]->getName());
+
+            std::vector<int> overlayBase = _matchSiblings(baseKeys, overlayKeys);
+            std::vector<bool> removed(base->fields.size(), false);
+
+            for (size_t j = 0; j < overlay->fields.size(); j++) {
+                SoffitField* field = overlay->fields[j];
+                if (policy == SoffitMergePolicy::DeleteMarker && field->getValue() == SOFFIT_DELETE) {
+                    if (overlayBase[j] >= 0)
+                        removed[overlayBase[j]] = true;
+                    leftFields.push_back(field);
+                }
+                else if (overlayBase[j] >= 0) {
+                    base->fields[overlayBase[j]]->setValue(field->getValue());
+                    leftFields.push_back(field);
+                }
+                else {
+                    field->setParent(base);
+                    base->fields.push_back(field);
+                }
+            }
+
+            _compactSiblings(base->fields, removed);
+        }
+        overlay->fields.swap(leftFields);
+
+        //Objects
+        std::vector<std::string> baseKeys;
+        std::vector<std::string> overlayKeys;
+        baseKeys.reserve(base->objects.size());
+        overlayKeys.reserve(overlay->objects.size());
+        for (size_t i = 0; i < base->objects.size(); i++)
+            baseKeys.push_back(base->objects[i]->type + '\0' + base->objects[i]->name);
+        for (size_t j = 0; j < overlay->objects.size(); j++)
+            overlayKeys.push_back(overlay->objects[j]->type + '\0' + overlay->objects[j]->name);
+
+        std::vector<int> overlayBase = _matchSiblings(baseKeys, overlayKeys);
+        std::vector<bool> removed(base->objects.size(), false);
+        std::vector<SoffitObject*> leftObjects;
+
+        for (size_t j = 0; j < overlay->objects.size(); j++) {
+            SoffitObject* object = overlay->objects[j];
+            if (policy == SoffitMergePolicy::DeleteMarker && object->hasField(SOFFIT_DELETE)) {
+                if (overlayBase[j] >= 0)
+                    removed[overlayBase[j]] = true;
+                leftObjects.push_back(object);
+            }
+            else if (overlayBase[j] >= 0) {
+                _mergeObjects(base->objects[overlayBase[j]], object, policy);
+                leftObjects.push_back(object);
+            }
+            else {
+                object->setParent(base);
+                base->objects.push_back(object);
+            }
+        }
+
+        _compactSiblings(base->objects, removed);
+        overlay->objects.swap(leftObjects);
+    }
+}
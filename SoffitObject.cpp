@@ -35,20 +35,23 @@ namespace CPPSoffit {
     SoffitObject::SoffitObject(std::string type, std::string name) {
         this->type = type;
         this->name = name;
-
-        reserveInitialVectorCapacity();
     }
 
     SoffitObject::SoffitObject(std::string type) {
         this->type = type;
         name = "";
-
-        reserveInitialVectorCapacity();
     }
 
     SoffitObject::~SoffitObject() {
         setParent(nullptr);
 
+        if (extras != nullptr) {
+            delete extras->lazyBody;
+            delete extras->index;
+            delete extras->writeCache;
+            delete extras;
+        }
+
         //Delete all stored objects
         while (objects.size() > 0) {
             delete objects.back();
@@ -79,24 +82,61 @@ namespace CPPSoffit {
     }
 
     void SoffitObject::setName(std::string name) {
+        SoffitIndex* index = parent != nullptr ? documentIndex() : nullptr;
+        if (index != nullptr)
+            index->removeNode(this);
+
         this->name = name;
+        invalidateHash();
+
+        if (index != nullptr)
+            index->addNode(this);
     }
 
     void SoffitObject::setType(std::string type) {
+        SoffitIndex* index = parent != nullptr ? documentIndex() : nullptr;
+        if (index != nullptr)
+            index->removeNode(this);
+
         this->type = type;
+        invalidateHash();
+
+        if (index != nullptr)
+            index->addNode(this);
     }
 
     void SoffitObject::add(SoffitField* field) {
+        if (!isBodyParsed())
+            parseLazyBody();
+        invalidateHash();
+
         field->setParent(this);
         fields.push_back(field);
     }
 
     void SoffitObject::add(SoffitObject* object) {
+        if (!isBodyParsed())
+            parseLazyBody();
+        invalidateHash();
+
+        //A root joining another document gives up its own index
+        if (object->extras != nullptr) {
+            delete object->extras->index;
+            object->extras->index = nullptr;
+        }
+
         object->setParent(this);
         objects.push_back(object);
+
+        SoffitIndex* index = documentIndex();
+        if (index != nullptr)
+            index->insertSubtree(object);
     }
 
     SoffitObject* SoffitObject::getObject(std::string objectName) {
+        if (!isBodyParsed())
+            parseLazyBody();
+
         for (int i = 0; i < objects.size(); i++) {
             if (objects.at(i)->getName() == objectName) {
                 return objects.at(i);
@@ -106,6 +146,9 @@ namespace CPPSoffit {
     }
 
     SoffitObject* SoffitObject::getFirstObject() {
+        if (!isBodyParsed())
+            parseLazyBody();
+
         if (objects.size() > 0)
             return objects.at(0);
 
@@ -113,6 +156,9 @@ namespace CPPSoffit {
     }
 
     SoffitObject* SoffitObject::getObjectByTypeAndName(std::string type, std::string name) {
+        if (!isBodyParsed())
+            parseLazyBody();
+
         for (int i = 0; i < objects.size(); i++) {
             if (objects.at(i)->getType() == type && objects.at(i)->getName() == name)
                 return objects.at(i);
@@ -122,6 +168,9 @@ namespace CPPSoffit {
     }
 
     std::vector<SoffitObject*> SoffitObject::getObjectsByName(std::string objectsName) {
+        if (!isBodyParsed())
+            parseLazyBody();
+
         std::vector<SoffitObject*> foundObjects;
 
         for (int i = 0; i < objects.size(); i++) {
@@ -134,6 +183,9 @@ namespace CPPSoffit {
     }
 
     std::vector<SoffitObject*> SoffitObject::getObjectsByType(std::string objectsType) {
+        if (!isBodyParsed())
+            parseLazyBody();
+
         std::vector<SoffitObject*> foundObjects;
 
         for (int i = 0; i < objects.size(); i++) {
@@ -146,10 +198,16 @@ namespace CPPSoffit {
     }
 
     std::vector<SoffitObject*> SoffitObject::getAllObjects() {
+        if (!isBodyParsed())
+            parseLazyBody();
+
         return objects;
     }
 
     SoffitField* SoffitObject::getField(std::string fieldName) {
+        if (!isBodyParsed())
+            parseLazyBody();
+
         for (int i = 0; i < fields.size(); i++) {
             if (fields[i]->getName() == fieldName) {
                 return fields[i];
@@ -159,6 +217,9 @@ namespace CPPSoffit {
     }
 
     bool SoffitObject::hasField(std::string fieldName) {
+        if (!isBodyParsed())
+            parseLazyBody();
+
         for (int i = 0; i < fields.size(); i++) {
             if (fields[i]->getName() == fieldName) {
                 return true;
@@ -168,6 +229,9 @@ namespace CPPSoffit {
     }
 
     std::vector<SoffitField*> SoffitObject::getFieldsByName(std::string fieldName) {
+        if (!isBodyParsed())
+            parseLazyBody();
+
         std::vector<SoffitField*> foundFields;
 
         for (int i = 0; i < fields.size(); i++) {
@@ -180,14 +244,23 @@ namespace CPPSoffit {
     }
 
     std::vector<SoffitField*> SoffitObject::getAllFields() {
+        if (!isBodyParsed())
+            parseLazyBody();
+
         return fields;
     }
 
     bool SoffitObject::hasObjects() {
+        if (!isBodyParsed())
+            parseLazyBody();
+
         return objects.size() > 0;
     }
 
     bool SoffitObject::hasFields() {
+        if (!isBodyParsed())
+            parseLazyBody();
+
         return fields.size() > 0;
     }
 
@@ -196,8 +269,13 @@ namespace CPPSoffit {
     }
 
     void SoffitObject::deleteObject(std::string name) {
+        if (!isBodyParsed())
+            parseLazyBody();
+        invalidateHash();
+
         for (int i = 0; i < objects.size(); i++) {
             if (objects[i]->getName() == name) {
+                unindex(objects[i]);
                 delete objects[i];
                 objects.erase(objects.begin() + i);
                 return;
@@ -206,8 +284,14 @@ namespace CPPSoffit {
     }
 
     void SoffitObject::deleteObjectsByType(std::string type) {
-        for (int i = 0; i < objects.size(); i++) {
+        if (!isBodyParsed())
+            parseLazyBody();
+        invalidateHash();
+
+        //Walk backwards, so that erasing does not move the children still to be checked
+        for (int i = (int) objects.size() - 1; i >= 0; i--) {
             if (objects[i]->getType() == type) {
+                unindex(objects[i]);
                 delete objects[i];
                 objects.erase(objects.begin() + i);
             }
@@ -215,13 +299,22 @@ namespace CPPSoffit {
     }
 
     void SoffitObject::deleteAllObjects() {
-        for (int i = 0; i < objects.size(); i++) {
+        if (!isBodyParsed())
+            parseLazyBody();
+        invalidateHash();
+
+        while (!objects.empty()) {
+            unindex(objects.back());
             delete objects.back();
             objects.pop_back();
         }
     }
 
     void SoffitObject::deleteField(std::string name) {
+        if (!isBodyParsed())
+            parseLazyBody();
+        invalidateHash();
+
         for (int i = 0; i < fields.size(); i++) {
             if (fields.at(i)->getName() == name) {
                 delete fields[i];
@@ -232,15 +325,24 @@ namespace CPPSoffit {
     }
 
     void SoffitObject::deleteAllFields() {
-        for (int i = 0; i < fields.size(); i++) {
+        if (!isBodyParsed())
+            parseLazyBody();
+        invalidateHash();
+
+        while (!fields.empty()) {
             delete fields.back();
             fields.pop_back();
         }
     }
 
     void SoffitObject::detachObject(std::string name) {
+        if (!isBodyParsed())
+            parseLazyBody();
+        invalidateHash();
+
         for (int i = 0; i < objects.size(); i++) {
             if (objects.at(i)->getName() == name) {
+                unindex(objects[i]);
                 objects[i]->setParent(nullptr);
                 objects.erase(objects.begin() + i);
                 return;
@@ -249,8 +351,13 @@ namespace CPPSoffit {
     }
 
     void SoffitObject::detachObject(SoffitObject* child) {
+        if (!isBodyParsed())
+            parseLazyBody();
+        invalidateHash();
+
         for (int i = 0; i < objects.size(); i++) {
             if (objects.at(i) == child) {
+                unindex(objects[i]);
                 objects[i]->setParent(nullptr);
                 objects.erase(objects.begin() + i);
                 return;
@@ -259,8 +366,14 @@ namespace CPPSoffit {
     }
 
     void SoffitObject::detachObjectsByType(std::string type) {
-        for (int i = 0; i < objects.size(); i++) {
+        if (!isBodyParsed())
+            parseLazyBody();
+        invalidateHash();
+
+        //Walk backwards, so that erasing does not move the children still to be checked
+        for (int i = (int) objects.size() - 1; i >= 0; i--) {
             if (objects.at(i)->getType() == type) {
+                unindex(objects[i]);
                 objects[i]->setParent(nullptr);
                 objects.erase(objects.begin() + i);
             }
@@ -268,13 +381,22 @@ namespace CPPSoffit {
     }
 
     void SoffitObject::detachAllObjects() {
+        if (!isBodyParsed())
+            parseLazyBody();
+        invalidateHash();
+
         for (int i = 0; i < objects.size(); i++) {
+            unindex(objects[i]);
             objects[i]->setParent(nullptr);
         }
         objects.clear();
     }
 
     void SoffitObject::detachField(std::string name) {
+        if (!isBodyParsed())
+            parseLazyBody();
+        invalidateHash();
+
         for (int i = 0; i < fields.size(); i++) {
             if (fields[i]->getName() == name) {
                 fields[i]->setParent(nullptr);
@@ -285,6 +407,10 @@ namespace CPPSoffit {
     }
 
     void SoffitObject::detachAllFields() {
+        if (!isBodyParsed())
+            parseLazyBody();
+        invalidateHash();
+
         for (int i = 0; i < fields.size(); i++) {
             fields[i]->setParent(nullptr);
         }
@@ -300,6 +426,301 @@ namespace CPPSoffit {
         recursivelyCalculateNestingLevel();
     }
 
+    void SoffitObject::shrinkToFit() {
+        if (!isBodyParsed())
+            return;
+
+        type.shrink_to_fit();
+        name.shrink_to_fit();
+        fields.shrink_to_fit();
+        objects.shrink_to_fit();
+
+        for (size_t i = 0; i < fields.size(); i++)
+            fields[i]->shrinkToFit();
+
+        for (size_t i = 0; i < objects.size(); i++)
+            objects[i]->shrinkToFit();
+    }
+
+    size_t SoffitObject::memoryUsage() {
+        std::vector<const std::string*> sources;
+        return memoryUsage(sources);
+    }
+
+    //sources collects the lazily read buffers already counted, since a whole document shares one
+    size_t SoffitObject::memoryUsage(std::vector<const std::string*>& sources) {
+        size_t bytes = sizeof(SoffitObject) + _heapUsage(type) + _heapUsage(name);
+        bytes += fields.capacity() * sizeof(SoffitField*) + objects.capacity() * sizeof(SoffitObject*);
+
+        if (!isBodyParsed()) {
+            bytes += sizeof(LazyBody);
+
+            const std::string* source = extras->lazyBody->source.get();
+            bool counted = false;
+            for (size_t i = 0; i < sources.size() && !counted; i++)
+                counted = sources[i] == source;
+
+            if (!counted) {
+                sources.push_back(source);
+                bytes += sizeof(std::string) + _heapUsage(*source);
+            }
+        }
+
+        for (size_t i = 0; i < fields.size(); i++)
+            bytes += fields[i]->memoryUsage();
+
+        for (size_t i = 0; i < objects.size(); i++)
+            bytes += objects[i]->memoryUsage(sources);
+
+        if (extras != nullptr) {
+            bytes += sizeof(Extras);
+
+            if (extras->index != nullptr)
+                bytes += extras->index->memoryUsage();
+
+            WriteCache* cache = extras->writeCache;
+            if (cache != nullptr)
+                bytes += sizeof(WriteCache) + _heapUsage(cache->text[0]) + _heapUsage(cache->text[1]);
+        }
+
+        return bytes;
+    }
+
+    void SoffitObject::dropWriteCache() {
+        //The text kept by ancestors includes this subtree, so it goes too.  Otherwise a later edit here would stop
+        //at this object in invalidateHash, and leave their text stale
+        for (SoffitObject* ancestor = parent; ancestor != nullptr && ancestor->extras != nullptr && ancestor->extras->writeValid; ancestor = ancestor->parent)
+            ancestor->extras->writeValid = 0;
+
+        if (extras != nullptr) {
+            extras->writeValid = 0;
+            delete extras->writeCache;
+            extras->writeCache = nullptr;
+        }
+
+        for (size_t i = 0; i < objects.size(); i++)
+            objects[i]->dropWriteCache();
+    }
+
+    uint64_t SoffitObject::getHash() {
+        if (extras != nullptr && extras->hashValid)
+            return extras->hash;
+
+        if (!isBodyParsed())
+            parseLazyBody();
+
+        //The counts keep a field from hashing the same as a child object, and a child from hashing the same as its parent
+        uint64_t h = _hashCombine(_hashString(type), _hashString(name));
+        h = _hashCombine(h, fields.size());
+        for (size_t i = 0; i < fields.size(); i++) {
+            h = _hashCombine(h, _hashString(fields[i]->name));
+            h = _hashCombine(h, _hashString(fields[i]->value));
+        }
+
+        h = _hashCombine(h, objects.size());
+        for (size_t i = 0; i < objects.size(); i++)
+            h = _hashCombine(h, objects[i]->getHash());
+
+        Extras* cached = getExtras();
+        cached->hash = h;
+        cached->hashValid = true;
+        return h;
+    }
+
+    bool SoffitObject::equals(SoffitObject* other) {
+        if (other == this)
+            return true;
+
+        if (getHash() != other->getHash())
+            return false;
+
+        //Equal hashes are all but certain to mean equal trees, but confirm it
+        if (type != other->type || name != other->name)
+            return false;
+        if (fields.size() != other->fields.size() || objects.size() != other->objects.size())
+            return false;
+
+        for (size_t i = 0; i < fields.size(); i++) {
+            if (fields[i]->name != other->fields[i]->name || fields[i]->value != other->fields[i]->value)
+                return false;
+        }
+
+        for (size_t i = 0; i < objects.size(); i++) {
+            if (!objects[i]->equals(other->objects[i]))
+                return false;
+        }
+
+        return true;
+    }
+
+    //A valid hash or write cache implies the same all the way down, so the walk can stop at the first ancestor
+    //with neither.  The write cache is cleared here too, as every mutator already calls this.
+    void SoffitObject::invalidateHash() {
+        for (SoffitObject* object = this; object != nullptr && object->extras != nullptr; object = object->parent) {
+            Extras* cached = object->extras;
+            if (!cached->hashValid && !cached->writeValid)
+                break;
+
+            cached->hashValid = false;
+            cached->writeValid = 0;
+        }
+    }
+
+    //Forgets the unparsed body and cached state of an object that SoffitParseContext reuses for a new document.
+    //The write cache is kept for its buffers, and any order key is left for the index, which is rebuilt anyway.
+    void SoffitObject::resetCaches() {
+        if (extras == nullptr)
+            return;
+
+        delete extras->lazyBody;
+        extras->lazyBody = nullptr;
+        extras->hashValid = false;
+        extras->writeValid = 0;
+    }
+
+    SoffitObject::Extras* SoffitObject::getExtras() {
+        if (extras == nullptr)
+            extras = new Extras();
+
+        return extras;
+    }
+
+    //Returns the fields and child objects of this object as _writeObjects writes them.  Only subtrees that have
+    //changed since the last call are serialized again; the text of the others is copied as it is.
+    const std::string& SoffitObject::serializedBody(bool indent) {
+        if (!isBodyParsed())
+            parseLazyBody();
+
+        Extras* cached = getExtras();
+        if (cached->writeCache == nullptr)
+            cached->writeCache = new WriteCache();
+
+        //Indented text also depends on the nesting level, which changes when a subtree is moved
+        unsigned char mode = indent ? 2 : 1;
+        WriteCache* writeCache = cached->writeCache;
+        std::string& text = writeCache->text[indent ? 1 : 0];
+        if ((cached->writeValid & mode) && (!indent || writeCache->nestingLevel == nestingLevel))
+            return text;
+
+        text.clear();
+        size_t tabs = indent ? nestingLevel + 1 : 0;
+
+        for (size_t i = 0; i < fields.size(); i++) {
+            SoffitField* field = fields[i];
+
+            text.append(tabs, '\t');
+            text.append(field->name);
+            if (!field->value.empty()) {
+                text.append(" \"");
+                _appendEscaped(text, field->value);
+                text.append("\"\n");
+            }
+            else {
+                text.push_back('\n');
+            }
+        }
+
+        for (size_t i = 0; i < objects.size(); i++) {
+            SoffitObject* object = objects[i];
+            const std::string& body = object->serializedBody(indent);
+            size_t objectTabs = indent ? object->nestingLevel : 0;
+
+            text.append(objectTabs, '\t');
+            text.append(object->type);
+            if (!object->name.empty()) {
+                text.append(" \"");
+                _appendEscaped(text, object->name);
+                text.append("\" {\n");
+            }
+            else {
+                text.append(" {\n");
+            }
+
+            text.append(body);
+            text.append(objectTabs, '\t');
+            text.append("}\n");
+        }
+
+        if (indent)
+            writeCache->nestingLevel = nestingLevel;
+        cached->writeValid |= mode;
+        return text;
+    }
+
+    //Only objects in a document that has been indexed have an order key, so others skip the walk to the root
+    SoffitIndex* SoffitObject::documentIndex() {
+        if (extras == nullptr || extras->order == 0)
+            return nullptr;
+
+        SoffitObject* root = this;
+        while (root->parent != nullptr)
+            root = root->parent;
+
+        return root->extras->index;
+    }
+
+    //Called before a child is deleted or detached, while its subtree is still in place
+    void SoffitObject::unindex(SoffitObject* child) {
+        SoffitIndex* index = documentIndex();
+        if (index != nullptr)
+            index->removeSubtree(child);
+    }
+
+    //Used by changes made outside the mutators above, which would be costly to track; the next query rebuilds the index
+    void SoffitObject::dropIndex() {
+        SoffitObject* root = this;
+        while (root->parent != nullptr)
+            root = root->parent;
+
+        if (root->extras != nullptr) {
+            delete root->extras->index;
+            root->extras->index = nullptr;
+        }
+    }
+
+    SoffitObject* SoffitObject::clone() {
+        if (!isBodyParsed())
+            parseLazyBody();
+
+        SoffitObject* copy = new SoffitObject(type, name);
+
+        for (size_t i = 0; i < fields.size(); i++) {
+            copy->add(new SoffitField(fields[i]->getName(), fields[i]->getValue()));
+        }
+
+        for (size_t i = 0; i < objects.size(); i++) {
+            copy->add(objects[i]->clone());
+        }
+
+        return copy;
+    }
+
+    SoffitObjectRange SoffitObject::getDescendantsByType(std::string type) {
+        return SoffitIndex::of(this)->find(this, type);
+    }
+
+    SoffitObjectRange SoffitObject::findAll(std::string type, std::string name) {
+        return SoffitIndex::of(this)->find(this, type, name);
+    }
+
+    bool SoffitObject::isBodyParsed() {
+        return extras == nullptr || extras->lazyBody == nullptr;
+    }
+
+    void SoffitObject::setLazyBody(std::shared_ptr<const std::string> source, size_t begin, size_t end, int lineNumber) {
+        Extras* state = getExtras();
+        delete state->lazyBody;
+        state->lazyBody = new LazyBody{ source, begin, end, lineNumber };
+    }
+
+    void SoffitObject::parseLazyBody() {
+        //Detach the body first, so that adding the parsed properties does not recurse back into here
+        std::unique_ptr<LazyBody> body(extras->lazyBody);
+        extras->lazyBody = nullptr;
+
+        _parseLazyBody(this, body->source, body->begin, body->end, body->lineNumber, false);
+    }
+
     void SoffitObject::calculateNestingLevel() {
         if (parent != nullptr) {
             nestingLevel = parent->getNestingLevel() + 1;
@@ -327,9 +748,4 @@ namespace CPPSoffit {
         //calculateNestingLevel();
         recursivelyCalculateNestingLevel();
     }
-
-    void SoffitObject::reserveInitialVectorCapacity() {
-        objects.reserve(initialVectorCapacity);
-        fields.reserve(initialVectorCapacity);
-    }
 }
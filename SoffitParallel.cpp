@@ -0,0 +1,278 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+#include <exception>
+
+namespace CPPSoffit {
+
+    //The pool and index of the worker running on this thread, if any
+    static thread_local SoffitThreadPool* currentPool = nullptr;
+    static thread_local int currentIndex = -1;
+
+    // One object whose children are being visited.  The root's frame has no object, and holds the root as its only child.
+    struct VisitFrame {
+        SoffitObject* object;
+        SoffitObject* const* children;
+        VisitFrame* parent;
+        std::atomic<size_t> pending;
+    };
+
+    struct VisitJob {
+        std::function<void(SoffitObject*)> preOrder;
+        std::function<void(SoffitObject*)> postOrder;
+        SoffitObject* root;
+        VisitFrame top;
+
+        std::atomic<bool> failed{ false };
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable finished;
+        bool done = false;
+    };
+
+    SoffitThreadPool::SoffitThreadPool(size_t threadCount) {
+        if (threadCount == 0)
+            threadCount = std::thread::hardware_concurrency();
+        if (threadCount == 0)
+            threadCount = 1;
+
+        for (size_t i = 0; i < threadCount; i++)
+            workers.push_back(new Worker());
+
+        for (size_t i = 0; i < threadCount; i++)
+            threads.emplace_back(&SoffitThreadPool::run, this, i);
+    }
+
+    SoffitThreadPool::~SoffitThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+
+        for (size_t i = 0; i < threads.size(); i++)
+            threads[i].join();
+
+        for (size_t i = 0; i < workers.size(); i++)
+            delete workers[i];
+    }
+
+    size_t SoffitThreadPool::getThreadCount() {
+        return workers.size();
+    }
+
+    void SoffitThreadPool::push(const SoffitThreadPoolTask& task) {
+        size_t index = currentPool == this ? currentIndex : nextWorker++ % workers.size();
+
+        {
+            std::lock_guard<std::mutex> lock(workers[index]->mutex);
+            workers[index]->tasks.push_back(task);
+        }
+
+        //A worker counts itself as sleeping before it checks queued, so one of the two always sees the other
+        queued++;
+        if (sleeping > 0) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            wake.notify_one();
+        }
+    }
+
+    int SoffitThreadPool::currentWorker() {
+        return currentIndex;
+    }
+
+    SoffitThreadPool& SoffitThreadPool::shared() {
+        static SoffitThreadPool pool;
+        return pool;
+    }
+
+    void SoffitThreadPool::run(size_t index) {
+        currentPool = this;
+        currentIndex = (int) index;
+
+        SoffitThreadPoolTask task;
+        while (true) {
+            if (take(index, task)) {
+                task.run(*this, task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleeping++;
+            wake.wait(lock, [this] { return queued > 0 || stopping; });
+            sleeping--;
+
+            if (stopping && queued == 0)
+                return;
+        }
+    }
+
+    // Takes the newest task from this worker's own queue, or failing that the oldest task from another worker's
+    bool SoffitThreadPool::take(size_t index, SoffitThreadPoolTask& task) {
+        for (size_t i = 0; i < workers.size(); i++) {
+            Worker* worker = workers[(index + i) % workers.size()];
+            std::lock_guard<std::mutex> lock(worker->mutex);
+
+            if (worker->tasks.empty())
+                continue;
+
+            if (i == 0) {
+                task = worker->tasks.back();
+                worker->tasks.pop_back();
+            }
+            else {
+                task = worker->tasks.front();
+                worker->tasks.pop_front();
+            }
+
+            queued--;
+            return true;
+        }
+
+        return false;
+    }
+
+    void ParallelForEach(SoffitObject* root, std::function<void(SoffitObject*)> preOrder, std::function<void(SoffitObject*)> postOrder, SoffitThreadPool& pool) {
+        VisitJob job;
+        job.preOrder = preOrder;
+        job.postOrder = postOrder;
+        job.root = root;
+        job.top.object = nullptr;
+        job.top.children = &job.root;
+        job.top.parent = nullptr;
+        job.top.pending = 1;
+
+        pool.push({ _visitObjects, &job, &job.top, 0, 1 });
+
+        std::unique_lock<std::mutex> lock(job.mutex);
+        job.finished.wait(lock, [&job] { return job.done; });
+
+        if (job.error)
+            std::rethrow_exception(job.error);
+    }
+
+    void ParallelForEach(SoffitObject* root, std::function<void(SoffitObject*)> preOrder, std::function<void(SoffitObject*)> postOrder) {
+        ParallelForEach(root, preOrder, postOrder, SoffitThreadPool::shared());
+    }
+
+    //************************************************
+    //*********BEGIN INTERNAL IMPLEMENTATION**********
+    //************************************************
+
+    // Keeps the first exception thrown on a worker, to be rethrown by ParallelForEach.  Call from a catch block
+    static void _recordFailure(VisitJob* job) {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        if (!job->failed.exchange(true))
+            job->error = std::current_exception();
+    }
+
+    static void _callVisitor(VisitJob* job, const std::function<void(SoffitObject*)>& visitor, SoffitObject* object) {
+        if (!visitor || job->failed)
+            return;
+
+        try {
+            visitor(object);
+        }
+        catch (...) {
+            _recordFailure(job);
+        }
+    }
+
+    // Called once object and everything beneath it have been visited.  Finishing the last child of a frame
+    // finishes the frame's own object in turn, so the walk continues up until a frame still has children pending.
+    static void _finishObject(VisitJob* job, SoffitObject* object, VisitFrame* frame) {
+        while (true) {
+            _callVisitor(job, job->postOrder, object);
+
+            if (frame->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+
+            object = frame->object;
+            VisitFrame* parent = frame->parent;
+            if (parent == nullptr)
+                break;
+
+            delete frame;
+            frame = parent;
+        }
+
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->done = true;
+        job->finished.notify_all();
+    }
+
+    // Visits the children begin to end of a frame.  The upper half of the range is split off for other workers
+    // to steal until one child is left, which is then visited here before descending into its own children.
+    void _visitObjects(SoffitThreadPool& pool, const SoffitThreadPoolTask& task) {
+        VisitJob* job = (VisitJob*) task.job;
+        VisitFrame* frame = (VisitFrame*) task.data;
+        size_t begin = task.begin;
+        size_t end = task.end;
+
+        while (true) {
+            while (end - begin > 1) {
+                size_t middle = begin + (end - begin) / 2;
+                pool.push({ _visitObjects, job, frame, middle, end });
+                end = middle;
+            }
+
+            SoffitObject* object = frame->children[begin];
+            _callVisitor(job, job->preOrder, object);
+
+            //A lazily read body may be malformed, and must not throw on a worker thread
+            if (!object->isBodyParsed() && !job->failed) {
+                try {
+                    object->parseLazyBody();
+                }
+                catch (...) {
+                    _recordFailure(job);
+                }
+            }
+
+            //After a failure nothing more is visited, but the objects already started still have to finish
+            if (object->objects.empty() || job->failed) {
+                _finishObject(job, object, frame);
+                return;
+            }
+
+            VisitFrame* child = new VisitFrame();
+            child->object = object;
+            child->children = object->objects.data();
+            child->parent = frame;
+            child->pending = object->objects.size();
+
+            frame = child;
+            begin = 0;
+            end = object->objects.size();
+        }
+    }
+}
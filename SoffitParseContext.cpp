@@ -0,0 +1,233 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+
+namespace CPPSoffit {
+    SoffitParseContext::SoffitParseContext() {
+    }
+
+    SoffitParseContext::~SoffitParseContext() {
+        clear();
+    }
+
+    size_t SoffitParseContext::getPooledNodeCount() {
+        return freeObjects.size() + freeFields.size();
+    }
+
+    void SoffitParseContext::clear() {
+        //Pooled objects have already been emptied, so this deletes each node exactly once
+        for (size_t i = 0; i < freeObjects.size(); i++)
+            delete freeObjects[i];
+        for (size_t i = 0; i < freeFields.size(); i++)
+            delete freeFields[i];
+
+        freeObjects.clear();
+        freeFields.clear();
+    }
+
+    // Returns the child object at index, reusing the one already there, or else one from the pool
+    SoffitObject* SoffitParseContext::nextObject(SoffitObject* parent, size_t index) {
+        SoffitObject* object;
+
+        if (index < parent->objects.size()) {
+            object = parent->objects[index];
+
+            //An unparsed body and cached hash belong to the old document
+            object->resetCaches();
+        }
+        else {
+            if (!freeObjects.empty()) {
+                object = freeObjects.back();
+                freeObjects.pop_back();
+            }
+            else {
+                object = new SoffitObject("");
+            }
+
+            object->parent = parent;
+            object->nestingLevel = parent->nestingLevel + 1;
+            parent->objects.push_back(object);
+        }
+
+        return object;
+    }
+
+    // Returns the field at index, reusing the one already there, or else one from the pool
+    SoffitField* SoffitParseContext::nextField(SoffitObject* parent, size_t index) {
+        if (index < parent->fields.size())
+            return parent->fields[index];
+
+        SoffitField* field;
+        if (!freeFields.empty()) {
+            field = freeFields.back();
+            freeFields.pop_back();
+        }
+        else {
+            field = new SoffitField("");
+        }
+
+        field->parent = parent;
+        parent->fields.push_back(field);
+        return field;
+    }
+
+    // Moves the fields and child objects that the new document did not reuse into the pool
+    void SoffitParseContext::trim(Frame& frame) {
+        SoffitObject* object = frame.object;
+
+        for (size_t i = frame.fieldCount; i < object->fields.size(); i++) {
+            object->fields[i]->parent = nullptr;
+            freeFields.push_back(object->fields[i]);
+        }
+        object->fields.resize(frame.fieldCount);
+
+        for (size_t i = frame.objectCount; i < object->objects.size(); i++)
+            recycle(object->objects[i]);
+        object->objects.resize(frame.objectCount);
+    }
+
+    // Empties an object into the pool along with all of its descendants, keeping the capacity of their vectors and strings
+    void SoffitParseContext::recycle(SoffitObject* object) {
+        for (size_t i = 0; i < object->fields.size(); i++) {
+            object->fields[i]->parent = nullptr;
+            freeFields.push_back(object->fields[i]);
+        }
+
+        for (size_t i = 0; i < object->objects.size(); i++)
+            recycle(object->objects[i]);
+
+        object->fields.clear();
+        object->objects.clear();
+        object->resetCaches();
+        object->parent = nullptr;
+        freeObjects.push_back(object);
+    }
+
+    void ReadStreamInto(SoffitObject* root, std::istream& stream) {
+        SoffitParseContext context;
+        ReadStreamInto(root, stream, context);
+    }
+
+    void ReadStreamInto(SoffitObject* root, std::istream& stream, SoffitParseContext& context) {
+        SoffitError error;
+        if (!_readStreamInto(root, stream, context, error))
+            throw SoffitException(error);
+    }
+
+    bool TryReadStreamInto(SoffitObject* root, std::istream& stream, SoffitParseContext& context, SoffitError& error) {
+        return _readStreamInto(root, stream, context, error);
+    }
+
+    //************************************************
+    //*********BEGIN INTERNAL IMPLEMENTATION**********
+    //************************************************
+
+    // Follows the same rules as _parseObject, but overwrites the nodes already in the tree instead of creating new ones
+    bool _readStreamInto(SoffitObject* root, std::istream& stream, SoffitParseContext& context, SoffitError& error) {
+        int lineNumber = 0;
+        std::string& line = context.line;
+        std::vector<std::string>& tokens = context.tokens;
+
+        _getLine(stream, lineNumber, line);
+        if (line != SOFFIT_START)
+            return _fail(error, SoffitErrorCode::HeaderNotFound, "SOFFIT header not found.");
+
+        root->resetCaches();
+        root->invalidateHash();
+        root->dropIndex();
+
+        context.frames.clear();
+        context.frames.push_back({ root, 0, 0 });
+
+        while (true) {
+            _getLine(stream, lineNumber, line);
+
+            if (line.empty())
+                return _fail(error, SoffitErrorCode::IncompleteStream, "Incomplete SOFFIT stream.");
+
+            size_t count = _tokenizeLine(line, tokens);
+
+            //Ensure there are no double quotes in first token (The first token would be an object type or field name)
+            if (tokens[0].find('"') != std::string::npos)
+                return _fail(error, SoffitErrorCode::SyntaxError, "SOFFIT syntax error.", lineNumber);
+
+            if (count == 1 && tokens[0] == "}") {
+                if (context.frames.size() == 1)
+                    return _fail(error, SoffitErrorCode::TooManyClosingBrackets, "Too many closing brackets.", lineNumber);
+
+                context.trim(context.frames.back());
+                context.frames.pop_back();
+            }
+            else if (tokens[0] == SOFFIT_END) {
+                if (context.frames.size() != 1)
+                    return _fail(error, SoffitErrorCode::FooterInObject, "SOFFIT footer encountered in non-root object.", lineNumber);
+
+                context.trim(context.frames.back());
+                return true;
+            }
+            else if (_isObject(tokens, count)) {
+                SoffitParseContext::Frame& frame = context.frames.back();
+                SoffitObject* object = context.nextObject(frame.object, frame.objectCount++);
+
+                object->type.assign(tokens[0]);
+                if (count == 3) {
+                    object->name.assign(tokens[1], 1, tokens[1].size() - 2);
+                    if (!_convertFromEscapeSequenceInPlace(object->name, lineNumber, error))
+                        return false;
+                }
+                else {
+                    object->name.clear();
+                }
+
+                context.frames.push_back({ object, 0, 0 });
+            }
+            else if (_isField(tokens, count)) {
+                SoffitParseContext::Frame& frame = context.frames.back();
+                SoffitField* field = context.nextField(frame.object, frame.fieldCount++);
+
+                field->name.assign(tokens[0]);
+                field->parsedFlags = 0;
+                if (count > 1) {
+                    field->value.assign(tokens[1], 1, tokens[1].size() - 2);
+                    if (!_convertFromEscapeSequenceInPlace(field->value, lineNumber, error))
+                        return false;
+                }
+                else {
+                    field->value.clear();
+                }
+            }
+            else {
+                return _fail(error, SoffitErrorCode::SyntaxError, "SOFFIT syntax error.", lineNumber);
+            }
+        }
+    }
+}
@@ -0,0 +1,81 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+
+namespace CPPSoffit {
+    SoffitParseResult::SoffitParseResult(SoffitObject* document) {
+        this->document = document;
+    }
+
+    SoffitParseResult::SoffitParseResult(SoffitError&& error) {
+        document = nullptr;
+        this->error = std::move(error);
+    }
+
+    SoffitParseResult::SoffitParseResult(SoffitParseResult&& other) noexcept {
+        document = other.document;
+        error = std::move(other.error);
+        other.document = nullptr;
+    }
+
+    SoffitParseResult& SoffitParseResult::operator=(SoffitParseResult&& other) noexcept {
+        if (this != &other) {
+            delete document;
+            document = other.document;
+            error = std::move(other.error);
+            other.document = nullptr;
+        }
+        return *this;
+    }
+
+    SoffitParseResult::~SoffitParseResult() {
+        delete document;
+    }
+
+    bool SoffitParseResult::ok() const {
+        return error.code == SoffitErrorCode::None;
+    }
+
+    SoffitObject* SoffitParseResult::get() const {
+        return document;
+    }
+
+    SoffitObject* SoffitParseResult::release() {
+        SoffitObject* released = document;
+        document = nullptr;
+        return released;
+    }
+
+    const SoffitError& SoffitParseResult::getError() const {
+        return error;
+    }
+}
@@ -0,0 +1,69 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+
+namespace CPPSoffit {
+
+    void SoffitProjection::keepType(std::string type) {
+        types.insert(std::move(type));
+    }
+
+    void SoffitProjection::keepField(std::string name) {
+        fieldNames.insert(std::move(name));
+    }
+
+    void SoffitProjection::keepObjectsWhere(std::function<bool(const std::string& type, const std::string& name)> predicate) {
+        objectPredicate = std::move(predicate);
+    }
+
+    void SoffitProjection::keepFieldsWhere(std::function<bool(const std::string& name)> predicate) {
+        fieldPredicate = std::move(predicate);
+    }
+
+    bool SoffitProjection::keepsType(const std::string& type) const {
+        return types.empty() || types.count(type) != 0;
+    }
+
+    bool SoffitProjection::keepsObject(const std::string& type, const std::string& name) const {
+        if (!keepsType(type))
+            return false;
+
+        return !objectPredicate || objectPredicate(type, name);
+    }
+
+    bool SoffitProjection::keepsField(const std::string& name) const {
+        if (!fieldNames.empty() && fieldNames.count(name) == 0)
+            return false;
+
+        return !fieldPredicate || fieldPredicate(name);
+    }
+}
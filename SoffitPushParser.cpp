@@ -0,0 +1,395 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+#include <algorithm>
+
+namespace CPPSoffit {
+    void SoffitEventHandler::startField(const std::string& name, int /*lineNumber*/) {
+        chunkedName = name;
+        chunkedValue.clear();
+    }
+
+    void SoffitEventHandler::fieldChunk(const char* data, size_t length) {
+        chunkedValue.append(data, length);
+    }
+
+    void SoffitEventHandler::endField(int lineNumber) {
+        field(chunkedName, chunkedValue, lineNumber);
+
+        //Release the value rather than keep a large buffer for the life of the handler
+        std::string().swap(chunkedValue);
+    }
+
+    SoffitTreeBuilder::SoffitTreeBuilder() {
+        root = new SoffitObject("", "");
+        current = root;
+    }
+
+    SoffitTreeBuilder::~SoffitTreeBuilder() {
+        delete root;
+    }
+
+    void SoffitTreeBuilder::startObject(const std::string& type, const std::string& name, int /*lineNumber*/) {
+        SoffitObject* newObject = new SoffitObject(type, name);
+        current->add(newObject);
+        current = newObject;
+    }
+
+    void SoffitTreeBuilder::endObject(int lineNumber) {
+        if (current->isRoot())
+            throw SoffitException("Too many closing brackets.", lineNumber);
+        current = current->getParent();
+    }
+
+    void SoffitTreeBuilder::field(const std::string& name, const std::string& value, int /*lineNumber*/) {
+        current->add(new SoffitField(name, value));
+    }
+
+    void SoffitTreeBuilder::startField(const std::string& name, int /*lineNumber*/) {
+        chunked = new SoffitField(name);
+        current->add(chunked);
+    }
+
+    void SoffitTreeBuilder::fieldChunk(const char* data, size_t length) {
+        chunked->value.append(data, length);
+    }
+
+    void SoffitTreeBuilder::endField(int /*lineNumber*/) {
+        chunked = nullptr;
+    }
+
+    SoffitObject* SoffitTreeBuilder::takeRoot() {
+        SoffitObject* built = root;
+        root = new SoffitObject("", "");
+        current = root;
+        return built;
+    }
+
+    SoffitPushParser::SoffitPushParser() {
+        builder = new SoffitTreeBuilder();
+        handler = builder;
+
+        //The tree holds every value whole, so streaming them would only restrict the lines accepted
+        chunkThreshold = 0;
+    }
+
+    SoffitPushParser::SoffitPushParser(SoffitEventHandler* handler) {
+        this->handler = handler;
+    }
+
+    SoffitPushParser::~SoffitPushParser() {
+        delete builder;
+    }
+
+    size_t SoffitPushParser::feed(const char* data, size_t length) {
+        size_t pos = 0;
+
+        while (pos < length && !complete) {
+            if (streaming) {
+                pos = feedChunked(data + pos, data + length) - data;
+                continue;
+            }
+
+            size_t stop = pos;
+            while (stop < length && data[stop] != '\n' && data[stop] != '\r')
+                stop++;
+
+            //A line longer than the threshold is checked once for a field or object, whose string is then decoded as it arrives instead of the line being held whole
+            if (chunkThreshold > 0 && headerFound && !unchunked && pending.size() + (stop - pos) > chunkThreshold) {
+                size_t take = std::min(stop - pos, chunkThreshold + 1 - pending.size());
+                pending.append(data + pos, take);
+                pos += take;
+
+                if (!startChunkedField())
+                    unchunked = true;
+                continue;
+            }
+
+            //No terminator yet, keep the partial line for the next fragment
+            if (stop == length) {
+                pending.append(data + pos, length - pos);
+                return length;
+            }
+
+            if (pending.empty()) {
+                parseLine(data + pos, data + stop);
+            }
+            else {
+                pending.append(data + pos, stop - pos);
+                parseLine(pending.data(), pending.data() + pending.size());
+                pending.clear();
+            }
+
+            unchunked = false;
+            pos = stop + 1;
+        }
+
+        return pos;
+    }
+
+    SoffitObject* SoffitPushParser::finish() {
+        if (!complete && !pending.empty()) {
+            parseLine(pending.data(), pending.data() + pending.size());
+            pending.clear();
+        }
+
+        if (!complete) {
+            if (!headerFound)
+                throw SoffitException("SOFFIT header not found.");
+            throw SoffitException("Incomplete SOFFIT stream.");
+        }
+
+        if (builder != nullptr)
+            return builder->takeRoot();
+
+        return nullptr;
+    }
+
+    bool SoffitPushParser::isComplete() {
+        return complete;
+    }
+
+    int SoffitPushParser::getLineNumber() {
+        return lineNumber;
+    }
+
+    bool SoffitPushParser::hasStarted() {
+        if (headerFound)
+            return true;
+
+        size_t start = pending.find_first_not_of(" \t");
+        return start != std::string::npos && pending[start] != '#';
+    }
+
+    void SoffitPushParser::setChunkThreshold(size_t bytes) {
+        chunkThreshold = bytes;
+    }
+
+    void SoffitPushParser::reset() {
+        pending.clear();
+        lineNumber = 0;
+        depth = 0;
+        headerFound = false;
+        complete = false;
+        streaming = false;
+        escaped = false;
+        closed = false;
+        unchunked = false;
+
+        //Discard any partially built tree
+        if (builder != nullptr)
+            delete builder->takeRoot();
+    }
+
+    // Parse one complete line, following the same rules as _getLine and _parseObject
+    void SoffitPushParser::parseLine(const char* begin, const char* end) {
+        lineNumber++;
+
+        //Strip leading and trailing whitespace
+        while (begin < end && (*begin == ' ' || *begin == '\t'))
+            begin++;
+        while (end > begin && (*(end - 1) == ' ' || *(end - 1) == '\t'))
+            end--;
+
+        //Skip blank lines and comments
+        if (begin == end || *begin == '#')
+            return;
+
+        line.assign(begin, end);
+
+        if (!headerFound) {
+            if (line != SOFFIT_START)
+                throw SoffitException("SOFFIT header not found.");
+            headerFound = true;
+            return;
+        }
+
+        size_t count = _tokenizeLine(line, tokens);
+
+        //Ensure there are no double quotes in first token (The first token would be an object type or field name)
+        if (tokens[0].find('"') != std::string::npos)
+            throw SoffitException("SOFFIT syntax error.", lineNumber);
+
+        if (count == 1 && tokens[0] == "}") {
+            if (depth == 0)
+                throw SoffitException("Too many closing brackets.", lineNumber);
+
+            depth--;
+            handler->endObject(lineNumber);
+        }
+        else if (tokens[0] == SOFFIT_END) {
+            if (depth != 0)
+                throw SoffitException("SOFFIT footer encountered in non-root object.", lineNumber);
+
+            complete = true;
+            handler->endDocument(lineNumber);
+        }
+        else if (_isObject(tokens, count)) {
+            value.clear();
+            if (count == 3) {
+                value.assign(tokens[1], 1, tokens[1].size() - 2);
+                _convertFromEscapeSequenceInPlace(value, lineNumber);
+            }
+
+            depth++;
+            handler->startObject(tokens[0], value, lineNumber);
+        }
+        else if (_isField(tokens, count)) {
+            value.clear();
+            if (count == 2) {
+                value.assign(tokens[1], 1, tokens[1].size() - 2);
+                _convertFromEscapeSequenceInPlace(value, lineNumber);
+            }
+
+            handler->field(tokens[0], value, lineNumber);
+        }
+        else {
+            throw SoffitException("SOFFIT syntax error.", lineNumber);
+        }
+    }
+
+    // Check whether the long line held in pending starts with a name and a quoted string, and if so start decoding the
+    // string as it arrives.  pending holds no line terminator, so the whole of it can be decoded here
+    bool SoffitPushParser::startChunkedField() {
+        const char* p = pending.data();
+        const char* end = p + pending.size();
+
+        while (p < end && (*p == ' ' || *p == '\t'))
+            p++;
+
+        const char* nameBegin = p;
+        while (p < end && *p != ' ' && *p != '"')
+            p++;
+
+        if (p == nameBegin || p == end || *p != ' ')
+            return false;
+
+        //Leave anything parseLine would not read as a field or object to parseLine
+        line.assign(nameBegin, p);
+        if (line[0] == '#' || line == "}" || line == SOFFIT_END)
+            return false;
+
+        while (p < end && *p == ' ')
+            p++;
+
+        if (p == end || *p != '"')
+            return false;
+
+        lineNumber++;
+        streaming = true;
+        escaped = false;
+        closed = false;
+        separated = false;
+        opened = false;
+        value.clear();
+
+        feedChunked(p + 1, end);
+        pending.clear();
+        return true;
+    }
+
+    // Decode the next part of a long line's string, up to the end of the fragment or the end of the line.
+    // The line is a field or an object, depending on whether an opening bracket follows the string, so the string is
+    // held until the line ends and then passed on as one or the other.
+    // Returns the position after the bytes used, which is past the line terminator once the line ends
+    const char* SoffitPushParser::feedChunked(const char* p, const char* end) {
+        while (p < end) {
+            //Only whitespace, and for an object one opening bracket after it, may follow the closing quote
+            if (closed) {
+                if (*p == '\n' || *p == '\r') {
+                    streaming = false;
+                    finishChunked();
+                    return p + 1;
+                }
+
+                if (*p == ' ' || *p == '\t')
+                    separated = true;
+                else if (*p == '{' && separated && !opened)
+                    opened = true;
+                else
+                    throw SoffitException("SOFFIT syntax error.", lineNumber);
+
+                p++;
+                continue;
+            }
+
+            //Finish an escape sequence, which may have been split between fragments
+            if (escaped) {
+                switch (*p) {
+                case '"': value.push_back('"'); break;
+                case 'n': value.push_back('\n'); break;
+                case '\\': value.push_back('\\'); break;
+                default: throw SoffitException("Invalid escape sequence", lineNumber);
+                }
+                escaped = false;
+                p++;
+                continue;
+            }
+
+            const char* run = p;
+            while (p < end && *p != '"' && *p != '\\' && *p != '\n' && *p != '\r')
+                p++;
+            value.append(run, p - run);
+
+            if (p == end)
+                break;
+
+            if (*p == '"')
+                closed = true;
+            else if (*p == '\\')
+                escaped = true;
+            else
+                throw SoffitException("SOFFIT syntax error.", lineNumber);
+            p++;
+        }
+
+        return p;
+    }
+
+    // Pass on a long line once it has ended.  A field's value goes to the handler's streamed value events, which
+    // handlers that do not override them gather and pass to field
+    void SoffitPushParser::finishChunked() {
+        if (opened) {
+            depth++;
+            handler->startObject(line, value, lineNumber);
+        }
+        else {
+            handler->startField(line, lineNumber);
+            if (!value.empty())
+                handler->fieldChunk(value.data(), value.size());
+            handler->endField(lineNumber);
+        }
+
+        //The string was longer than the threshold, so its buffer is not kept for ordinary lines
+        std::string().swap(value);
+    }
+}
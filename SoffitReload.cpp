@@ -0,0 +1,372 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+#include <sstream>
+
+namespace CPPSoffit {
+    static const size_t NONE = (size_t) -1;
+
+    // A top level object's region of the new stream, found before anything is parsed
+    struct ReloadRegion {
+        size_t begin;
+        size_t end;
+        int lineNumber;
+        uint64_t fingerprint;
+    };
+
+    // A field line of the root in the new stream
+    struct ReloadField {
+        size_t begin;
+        size_t end;
+        int lineNumber;
+    };
+
+    // Hash of the root's own fields, to notice changes made to them between reloads
+    static uint64_t _hashRootFields(const std::vector<SoffitField*>& fields) {
+        uint64_t hash = 0;
+        for (size_t i = 0; i < fields.size(); i++) {
+            hash = _hashCombine(hash, _hashString(fields[i]->getName()));
+            hash = _hashCombine(hash, _hashString(fields[i]->getValue()));
+        }
+        return hash;
+    }
+
+    // Parse the new top level objects from their regions, using the full parser so that every line is checked.
+    // Each region is given its own footer, and its line numbers continue from where it starts in the stream
+    static void _parseRegions(const std::string& source, const std::vector<ReloadRegion>& found, const std::vector<size_t>& which, std::vector<SoffitObject*>& parsed) {
+        std::string text;
+        for (size_t w = 0; w < which.size(); w++) {
+            const ReloadRegion& region = found[which[w]];
+            text.append(source, region.begin, region.end - region.begin);
+            text += '\n';
+            text += SOFFIT_END;
+            text += '\n';
+        }
+
+        std::istringstream stream(text);
+        SoffitObject scratch("", "");
+        SoffitError error;
+        for (size_t w = 0; w < which.size(); w++) {
+            if (!_parseObject(stream, &scratch, found[which[w]].lineNumber - 1, error))
+                throw SoffitException(error);
+        }
+
+        //Take the parsed objects from the scratch root, which would otherwise delete them
+        parsed = scratch.getAllObjects();
+        scratch.detachAllObjects();
+    }
+
+    // Parse the root's field lines, as _parseLazyBody does
+    static void _parseRootFields(const std::string& source, const std::vector<ReloadField>& lines, std::vector<SoffitField*>& fields) {
+        std::string line;
+        std::vector<std::string> tokens;
+
+        for (size_t i = 0; i < lines.size(); i++) {
+            line.assign(source, lines[i].begin, lines[i].end - lines[i].begin);
+            _getLineTokens(line, tokens);
+
+            if (_containsCharacter(tokens[0], '"'))
+                throw SoffitException("SOFFIT syntax error.", lines[i].lineNumber);
+
+            std::string fieldValue = "";
+            if (tokens.size() > 1)
+                fieldValue = _stripQuotations(tokens[1]);
+
+            _convertFromEscapeSequenceInPlace(fieldValue, lines[i].lineNumber);
+            fields.push_back(new SoffitField(tokens[0], fieldValue));
+        }
+    }
+
+    SoffitReloadChanges::SoffitReloadChanges() {
+    }
+
+    SoffitReloadChanges::SoffitReloadChanges(SoffitReloadChanges&& other) noexcept {
+        added.swap(other.added);
+        removed.swap(other.removed);
+        fieldsChanged = other.fieldsChanged;
+        reordered = other.reordered;
+    }
+
+    SoffitReloadChanges& SoffitReloadChanges::operator=(SoffitReloadChanges&& other) noexcept {
+        if (this != &other) {
+            for (size_t i = 0; i < removed.size(); i++)
+                delete removed[i];
+            removed.clear();
+
+            added.swap(other.added);
+            removed.swap(other.removed);
+            fieldsChanged = other.fieldsChanged;
+            reordered = other.reordered;
+        }
+        return *this;
+    }
+
+    SoffitReloadChanges::~SoffitReloadChanges() {
+        for (size_t i = 0; i < removed.size(); i++)
+            delete removed[i];
+    }
+
+    const std::vector<SoffitObject*>& SoffitReloadChanges::getAdded() const {
+        return added;
+    }
+
+    const std::vector<SoffitObject*>& SoffitReloadChanges::getRemoved() const {
+        return removed;
+    }
+
+    bool SoffitReloadChanges::haveFieldsChanged() const {
+        return fieldsChanged;
+    }
+
+    bool SoffitReloadChanges::isReordered() const {
+        return reordered;
+    }
+
+    bool SoffitReloadChanges::hasChanges() const {
+        return !added.empty() || !removed.empty() || fieldsChanged || reordered;
+    }
+
+    SoffitReloader::SoffitReloader() {
+        root = new SoffitObject("", "");
+        fieldsHash = _hashRootFields(root->fields);
+    }
+
+    SoffitReloader::~SoffitReloader() {
+        delete root;
+    }
+
+    SoffitObject* SoffitReloader::getRoot() {
+        return root;
+    }
+
+    SoffitReloadChanges SoffitReloader::reloadFromString(std::string& stream) {
+        std::istringstream iss(stream);
+        return reload(iss);
+    }
+
+    SoffitReloadChanges SoffitReloader::reload(std::istream& stream) {
+        //Regions are located and fingerprinted over the whole stream before anything is parsed
+        std::string source;
+        std::vector<char> buffer(64 * 1024);
+        while (stream) {
+            stream.read(buffer.data(), (std::streamsize) buffer.size());
+            source.append(buffer.data(), (size_t) stream.gcount());
+        }
+
+        const char* data = source.data();
+        size_t pos = 0;
+        size_t end = source.size();
+        int lineNumber = 0;
+        size_t lineBegin;
+        size_t lineEnd;
+
+        if (!_nextLine(data, pos, end, lineNumber, lineBegin, lineEnd) || source.compare(lineBegin, lineEnd - lineBegin, SOFFIT_START) != 0)
+            throw SoffitException("SOFFIT header not found.");
+
+        std::vector<ReloadRegion> found;
+        std::vector<ReloadField> fieldLines;
+        uint64_t fieldsPrint = 0;
+
+        while (true) {
+            if (!_nextLine(data, pos, end, lineNumber, lineBegin, lineEnd))
+                throw SoffitException("Incomplete SOFFIT stream.");
+
+            SoffitLineKind kind = _classifyLine(data + lineBegin, data + lineEnd);
+            if (kind == SoffitLineKind::Footer)
+                break;
+
+            if (kind == SoffitLineKind::Close)
+                throw SoffitException("Too many closing brackets.", lineNumber);
+            if (kind == SoffitLineKind::Invalid)
+                throw SoffitException("SOFFIT syntax error.", lineNumber);
+
+            if (kind == SoffitLineKind::Field) {
+                fieldsPrint = _hashCombine(fieldsPrint, _hashBytes(data + lineBegin, lineEnd - lineBegin));
+                fieldLines.push_back({ lineBegin, lineEnd, lineNumber });
+                continue;
+            }
+
+            //Fingerprint the object's lines up to its matching closing bracket, counting brackets without building anything
+            ReloadRegion region;
+            region.begin = lineBegin;
+            region.lineNumber = lineNumber;
+            region.fingerprint = _hashBytes(data + lineBegin, lineEnd - lineBegin);
+
+            int depth = 1;
+            while (depth > 0) {
+                if (!_nextLine(data, pos, end, lineNumber, lineBegin, lineEnd))
+                    throw SoffitException("Incomplete SOFFIT stream.");
+
+                SoffitLineKind skipped = _classifyLine(data + lineBegin, data + lineEnd);
+                if (skipped == SoffitLineKind::Close)
+                    depth--;
+                else if (skipped == SoffitLineKind::Object)
+                    depth++;
+                else if (skipped == SoffitLineKind::Footer)
+                    throw SoffitException("SOFFIT footer encountered in non-root object.", lineNumber);
+                else if (skipped == SoffitLineKind::Invalid)
+                    throw SoffitException("SOFFIT syntax error.", lineNumber);
+
+                region.fingerprint = _hashCombine(region.fingerprint, _hashBytes(data + lineBegin, lineEnd - lineBegin));
+            }
+
+            region.end = lineEnd;
+            found.push_back(region);
+        }
+
+        //Find each old region's object in the root.  Normally the root holds exactly those objects, in the same order,
+        //which is checked by comparing pointers; otherwise they are looked up, as the objects behind pointers that have
+        //left the root may have been deleted
+        std::vector<SoffitObject*>& current = root->objects;
+        std::vector<size_t> position(regions.size(), NONE);
+        bool aligned = current.size() == regions.size();
+        for (size_t i = 0; aligned && i < regions.size(); i++)
+            aligned = current[i] == regions[i].object;
+
+        if (aligned) {
+            for (size_t i = 0; i < regions.size(); i++)
+                position[i] = i;
+        }
+        else {
+            std::unordered_map<SoffitObject*, size_t> at;
+            at.reserve(current.size());
+            for (size_t k = 0; k < current.size(); k++)
+                at[current[k]] = k;
+
+            for (size_t i = 0; i < regions.size(); i++) {
+                auto it = at.find(regions[i].object);
+                if (it != at.end())
+                    position[i] = it->second;
+            }
+        }
+
+        //Chain the old regions that can be kept by fingerprint, in document order.  An object that has been changed
+        //since it was parsed can not be kept
+        std::unordered_map<uint64_t, size_t> firstUnused;
+        std::vector<size_t> nextUnused(regions.size(), NONE);
+        firstUnused.reserve(regions.size());
+        for (size_t i = regions.size(); i-- > 0;) {
+            if (position[i] == NONE || regions[i].object->getHash() != regions[i].hash)
+                continue;
+
+            auto inserted = firstUnused.emplace(regions[i].fingerprint, i);
+            if (!inserted.second) {
+                nextUnused[i] = inserted.first->second;
+                inserted.first->second = i;
+            }
+        }
+
+        SoffitReloadChanges changes;
+        std::vector<SoffitObject*> objects(found.size(), nullptr);
+        std::vector<Region> kept(found.size());
+        std::vector<bool> keptCurrent(current.size(), false);
+        size_t lastKept = 0;
+        bool anyKept = false;
+
+        for (size_t j = 0; j < found.size(); j++) {
+            auto it = firstUnused.find(found[j].fingerprint);
+            if (it == firstUnused.end() || it->second == NONE)
+                continue;
+
+            size_t i = it->second;
+            it->second = nextUnused[i];
+
+            objects[j] = regions[i].object;
+            kept[j] = regions[i];
+            keptCurrent[position[i]] = true;
+
+            if (anyKept && i < lastKept)
+                changes.reordered = true;
+            lastKept = i;
+            anyKept = true;
+        }
+
+        //Parse everything new before the tree is touched, so that a malformed stream leaves it as it was
+        bool fieldsChanged = fieldsPrint != fieldsFingerprint || _hashRootFields(root->fields) != fieldsHash;
+        std::vector<SoffitField*> fields;
+        std::vector<size_t> which;
+        for (size_t j = 0; j < found.size(); j++) {
+            if (objects[j] == nullptr)
+                which.push_back(j);
+        }
+
+        try {
+            if (fieldsChanged)
+                _parseRootFields(source, fieldLines, fields);
+
+            _parseRegions(source, found, which, changes.added);
+        }
+        catch (...) {
+            for (size_t i = 0; i < fields.size(); i++)
+                delete fields[i];
+            throw;
+        }
+
+        for (size_t w = 0; w < which.size(); w++)
+            objects[which[w]] = changes.added[w];
+
+        //Splice the new objects in, and detach everything that is no longer in the stream
+        for (size_t k = 0; k < current.size(); k++) {
+            if (!keptCurrent[k]) {
+                current[k]->setParent(nullptr);
+                changes.removed.push_back(current[k]);
+            }
+        }
+
+        for (size_t w = 0; w < which.size(); w++) {
+            SoffitObject* object = objects[which[w]];
+            object->setParent(root);
+            kept[which[w]] = { object, found[which[w]].fingerprint, object->getHash() };
+        }
+
+        root->objects.swap(objects);
+
+        if (fieldsChanged) {
+            for (size_t i = 0; i < root->fields.size(); i++)
+                delete root->fields[i];
+            root->fields.swap(fields);
+            for (size_t i = 0; i < root->fields.size(); i++)
+                root->fields[i]->setParent(root);
+
+            changes.fieldsChanged = true;
+        }
+
+        root->invalidateHash();
+        root->dropIndex();
+
+        regions.swap(kept);
+        fieldsFingerprint = fieldsPrint;
+        fieldsHash = _hashRootFields(root->fields);
+
+        return changes;
+    }
+}
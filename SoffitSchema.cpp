@@ -0,0 +1,192 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+
+namespace CPPSoffit {
+    SoffitSchema::SoffitSchema(SoffitObject* schemaRoot) {
+        types.push_back(Type());
+
+        std::vector<SoffitObject*> definitions = schemaRoot->getAllObjects();
+
+        //Register every type first, so that the rules below can be compiled in any order
+        for (size_t i = 0; i < definitions.size(); i++) {
+            if (definitions[i]->getType() == "Root")
+                continue;
+
+            if (definitions[i]->getType() != "Type")
+                throw SoffitException("Invalid SOFFIT schema: unknown definition '" + definitions[i]->getType() + "'.");
+
+            if (typeIndices.count(definitions[i]->getName()) > 0)
+                throw SoffitException("Invalid SOFFIT schema: type '" + definitions[i]->getName() + "' is defined more than once.");
+
+            typeIndices[definitions[i]->getName()] = (int) types.size();
+            types.push_back(Type());
+        }
+
+        for (size_t i = 0; i < definitions.size(); i++) {
+            if (definitions[i]->getType() == "Root")
+                compileType(definitions[i], types[0]);
+            else
+                compileType(definitions[i], types[typeIndices[definitions[i]->getName()]]);
+        }
+    }
+
+    void SoffitSchema::compileType(SoffitObject* definition, Type& type) {
+        type.strict = type.strict || definition->hasField("Strict");
+
+        std::vector<SoffitObject*> rules = definition->getAllObjects();
+        for (size_t i = 0; i < rules.size(); i++) {
+            std::unordered_map<std::string, int>* ruleMap;
+
+            if (rules[i]->getType() == "Field")
+                ruleMap = &type.fieldRules;
+            else if (rules[i]->getType() == "Child")
+                ruleMap = &type.objectRules;
+            else
+                throw SoffitException("Invalid SOFFIT schema: unknown rule '" + rules[i]->getType() + "'.");
+
+            if (ruleMap->count(rules[i]->getName()) > 0)
+                throw SoffitException("Invalid SOFFIT schema: rule '" + rules[i]->getName() + "' is defined more than once.");
+
+            (*ruleMap)[rules[i]->getName()] = (int) type.rules.size();
+            type.rules.push_back(compileRule(rules[i]));
+        }
+    }
+
+    SoffitSchema::Rule SoffitSchema::compileRule(SoffitObject* definition) {
+        Rule rule;
+        rule.description = (definition->getType() == "Field" ? "Field '" : "Child object '") + definition->getName() + "'";
+
+        if (definition->hasField("Min") && !definition->getField("Min")->getValueAs(rule.min))
+            throw SoffitException("Invalid SOFFIT schema: Min of '" + definition->getName() + "' is not an integer.");
+
+        if (definition->hasField("Max") && !definition->getField("Max")->getValueAs(rule.max))
+            throw SoffitException("Invalid SOFFIT schema: Max of '" + definition->getName() + "' is not an integer.");
+
+        if (definition->hasField("Pattern")) {
+            try {
+                rule.pattern = std::regex(definition->getField("Pattern")->getValue(), std::regex::ECMAScript | std::regex::optimize);
+            }
+            catch (std::regex_error&) {
+                throw SoffitException("Invalid SOFFIT schema: Pattern of '" + definition->getName() + "' is not a valid regular expression.");
+            }
+            rule.hasPattern = true;
+        }
+
+        return rule;
+    }
+
+    SoffitValidator::SoffitValidator(const SoffitSchema* schema) {
+        this->schema = schema;
+        pushFrame(0);
+    }
+
+    bool SoffitValidator::enterObject(const std::string& type, const std::string& name, int lineNumber, SoffitError& error) {
+        Frame& frame = frames[depth - 1];
+
+        if (frame.type >= 0) {
+            const SoffitSchema::Type& parentType = schema->types[frame.type];
+            std::unordered_map<std::string, int>::const_iterator rule = parentType.objectRules.find(type);
+
+            if (rule != parentType.objectRules.end()) {
+                if (!countRule(frame, rule->second, name, lineNumber, error))
+                    return false;
+            }
+            else if (parentType.strict) {
+                return _fail(error, SoffitErrorCode::SchemaViolation, "Schema violation: child object of type '" + type + "' is not allowed here.", lineNumber);
+            }
+        }
+
+        std::unordered_map<std::string, int>::const_iterator childType = schema->typeIndices.find(type);
+        pushFrame(childType != schema->typeIndices.end() ? childType->second : -1);
+        return true;
+    }
+
+    bool SoffitValidator::field(const std::string& name, const std::string& value, int lineNumber, SoffitError& error) {
+        Frame& frame = frames[depth - 1];
+
+        if (frame.type < 0)
+            return true;
+
+        const SoffitSchema::Type& type = schema->types[frame.type];
+        std::unordered_map<std::string, int>::const_iterator rule = type.fieldRules.find(name);
+
+        if (rule != type.fieldRules.end())
+            return countRule(frame, rule->second, value, lineNumber, error);
+        else if (type.strict)
+            return _fail(error, SoffitErrorCode::SchemaViolation, "Schema violation: field '" + name + "' is not allowed here.", lineNumber);
+
+        return true;
+    }
+
+    bool SoffitValidator::exitObject(int lineNumber, SoffitError& error) {
+        Frame& frame = frames[depth - 1];
+
+        if (frame.type >= 0) {
+            const SoffitSchema::Type& type = schema->types[frame.type];
+
+            for (size_t i = 0; i < type.rules.size(); i++) {
+                if (frame.counts[i] < type.rules[i].min)
+                    return _fail(error, SoffitErrorCode::SchemaViolation, "Schema violation: " + type.rules[i].description + " is required.", lineNumber);
+            }
+        }
+
+        depth--;
+        return true;
+    }
+
+    bool SoffitValidator::countRule(Frame& frame, int rule, const std::string& value, int lineNumber, SoffitError& error) {
+        const SoffitSchema::Rule& r = schema->types[frame.type].rules[rule];
+
+        frame.counts[rule]++;
+        if (r.max >= 0 && frame.counts[rule] > r.max)
+            return _fail(error, SoffitErrorCode::SchemaViolation, "Schema violation: " + r.description + " appears too many times.", lineNumber);
+
+        if (r.hasPattern && !std::regex_match(value, r.pattern))
+            return _fail(error, SoffitErrorCode::SchemaViolation, "Schema violation: " + r.description + " does not match its pattern.", lineNumber);
+
+        return true;
+    }
+
+    //Frames are reused between objects so that their counters do not have to be reallocated
+    void SoffitValidator::pushFrame(int type) {
+        if (depth == (int) frames.size())
+            frames.push_back(Frame());
+
+        Frame& frame = frames[depth];
+        frame.type = type;
+        if (type >= 0)
+            frame.counts.assign(schema->types[type].rules.size(), 0);
+
+        depth++;
+    }
+}
@@ -0,0 +1,163 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+namespace CPPSoffit {
+    uint64_t SoffitStats::getNodesCreated() const {
+        return objectsCreated + fieldsCreated;
+    }
+
+    void SoffitStats::add(const SoffitStats& other) {
+        bytesRead += other.bytesRead;
+        linesRead += other.linesRead;
+        commentLinesSkipped += other.commentLinesSkipped;
+        blankLinesSkipped += other.blankLinesSkipped;
+        objectsCreated += other.objectsCreated;
+        fieldsCreated += other.fieldsCreated;
+        if (other.maxDepth > maxDepth)
+            maxDepth = other.maxDepth;
+        escapeSequencesDecoded += other.escapeSequencesDecoded;
+
+        bytesWritten += other.bytesWritten;
+        objectsWritten += other.objectsWritten;
+        fieldsWritten += other.fieldsWritten;
+        escapeSequencesEncoded += other.escapeSequencesEncoded;
+
+        ioSeconds += other.ioSeconds;
+        tokenizeSeconds += other.tokenizeSeconds;
+        unescapeSeconds += other.unescapeSeconds;
+        buildSeconds += other.buildSeconds;
+        writeSeconds += other.writeSeconds;
+    }
+
+    namespace {
+        struct RegistryEntry {
+            uint64_t calls = 0;
+            SoffitStats totals;
+        };
+
+        std::atomic<bool> registryEnabled(false);
+        std::mutex registryMutex;
+
+        //Function-local so that the registry is usable during static initialization
+        std::map<std::string, RegistryEntry>& registryEntries() {
+            static std::map<std::string, RegistryEntry> entries;
+            return entries;
+        }
+
+        void writeCounter(std::ostringstream& out, const char* name, const char* help,
+            const std::map<std::string, RegistryEntry>& entries, uint64_t SoffitStats::* counter) {
+            out << "# HELP " << name << " " << help << "\n";
+            out << "# TYPE " << name << " counter\n";
+            for (std::map<std::string, RegistryEntry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+                out << name << "{operation=\"" << it->first << "\"} " << it->second.totals.*counter << "\n";
+        }
+    }
+
+    void SoffitStatsRegistry::setEnabled(bool enabled) {
+        registryEnabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool SoffitStatsRegistry::isEnabled() {
+#ifdef CPPSOFFIT_NO_STATS
+        return false;
+#else
+        return registryEnabled.load(std::memory_order_relaxed);
+#endif
+    }
+
+    void SoffitStatsRegistry::record(const std::string& operation, const SoffitStats& stats) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        RegistryEntry& entry = registryEntries()[operation];
+        entry.calls++;
+        entry.totals.add(stats);
+    }
+
+    SoffitStats SoffitStatsRegistry::getTotals(const std::string& operation) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        std::map<std::string, RegistryEntry>::iterator it = registryEntries().find(operation);
+        if (it == registryEntries().end())
+            return SoffitStats();
+        return it->second.totals;
+    }
+
+    void SoffitStatsRegistry::reset() {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registryEntries().clear();
+    }
+
+    std::string SoffitStatsRegistry::toPrometheus() {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        const std::map<std::string, RegistryEntry>& entries = registryEntries();
+        std::ostringstream out;
+
+        out << "# HELP soffit_calls_total Completed SOFFIT operations.\n";
+        out << "# TYPE soffit_calls_total counter\n";
+        for (std::map<std::string, RegistryEntry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+            out << "soffit_calls_total{operation=\"" << it->first << "\"} " << it->second.calls << "\n";
+
+        writeCounter(out, "soffit_bytes_read_total", "Bytes read from SOFFIT streams.", entries, &SoffitStats::bytesRead);
+        writeCounter(out, "soffit_lines_read_total", "Lines read from SOFFIT streams.", entries, &SoffitStats::linesRead);
+        writeCounter(out, "soffit_comment_lines_skipped_total", "Comment lines skipped.", entries, &SoffitStats::commentLinesSkipped);
+        writeCounter(out, "soffit_blank_lines_skipped_total", "Blank lines skipped.", entries, &SoffitStats::blankLinesSkipped);
+        writeCounter(out, "soffit_objects_created_total", "Objects created by the parser.", entries, &SoffitStats::objectsCreated);
+        writeCounter(out, "soffit_fields_created_total", "Fields created by the parser.", entries, &SoffitStats::fieldsCreated);
+        writeCounter(out, "soffit_escape_sequences_decoded_total", "Escape sequences decoded.", entries, &SoffitStats::escapeSequencesDecoded);
+        writeCounter(out, "soffit_bytes_written_total", "Bytes written to SOFFIT streams.", entries, &SoffitStats::bytesWritten);
+        writeCounter(out, "soffit_objects_written_total", "Objects written.", entries, &SoffitStats::objectsWritten);
+        writeCounter(out, "soffit_fields_written_total", "Fields written.", entries, &SoffitStats::fieldsWritten);
+        writeCounter(out, "soffit_escape_sequences_encoded_total", "Escape sequences encoded.", entries, &SoffitStats::escapeSequencesEncoded);
+
+        out << "# HELP soffit_max_depth Deepest object nesting seen.\n";
+        out << "# TYPE soffit_max_depth gauge\n";
+        for (std::map<std::string, RegistryEntry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+            out << "soffit_max_depth{operation=\"" << it->first << "\"} " << it->second.totals.maxDepth << "\n";
+
+        out << "# HELP soffit_phase_seconds_total Time spent in each phase.\n";
+        out << "# TYPE soffit_phase_seconds_total counter\n";
+        for (std::map<std::string, RegistryEntry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+            const SoffitStats& t = it->second.totals;
+            const std::string& op = it->first;
+            out << "soffit_phase_seconds_total{operation=\"" << op << "\",phase=\"io\"} " << t.ioSeconds << "\n";
+            out << "soffit_phase_seconds_total{operation=\"" << op << "\",phase=\"tokenize\"} " << t.tokenizeSeconds << "\n";
+            out << "soffit_phase_seconds_total{operation=\"" << op << "\",phase=\"unescape\"} " << t.unescapeSeconds << "\n";
+            out << "soffit_phase_seconds_total{operation=\"" << op << "\",phase=\"build\"} " << t.buildSeconds << "\n";
+            out << "soffit_phase_seconds_total{operation=\"" << op << "\",phase=\"write\"} " << t.writeSeconds << "\n";
+        }
+
+        return out.str();
+    }
+}
@@ -0,0 +1,136 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "CPPSoffit.h"
+
+namespace CPPSoffit {
+    SoffitStreamWriter::SoffitStreamWriter(std::ostream& output, bool indent) {
+        this->output = &output;
+        this->indent = indent;
+    }
+
+    // Write the header on the first event of each document
+    void SoffitStreamWriter::begin() {
+        if (started)
+            return;
+
+        *output << SOFFIT_START << "\n";
+        started = true;
+        depth = 0;
+    }
+
+    void SoffitStreamWriter::writeIndent(int nestingLevel) {
+        if (indent) {
+            for (int i = 0; i < nestingLevel; i++)
+                output->put('\t');
+        }
+    }
+
+    void SoffitStreamWriter::startObject(const std::string& type, const std::string& name, int /*lineNumber*/) {
+        begin();
+
+        depth++;
+        writeIndent(depth);
+        *output << type;
+        if (name != "") {
+            *output << " \"";
+            _writeEscaped(*output, name);
+            *output << "\" {\n";
+        }
+        else {
+            *output << " {\n";
+        }
+    }
+
+    void SoffitStreamWriter::endObject(int lineNumber) {
+        if (depth == 0)
+            throw SoffitException("Too many closing brackets.", lineNumber);
+
+        writeIndent(depth);
+        *output << "}\n";
+        depth--;
+    }
+
+    void SoffitStreamWriter::field(const std::string& name, const std::string& value, int /*lineNumber*/) {
+        begin();
+
+        writeIndent(depth + 1);
+        *output << name;
+        if (value != "") {
+            *output << " \"";
+            _writeEscaped(*output, value);
+            *output << "\"\n";
+        }
+        else {
+            *output << "\n";
+        }
+    }
+
+    void SoffitStreamWriter::startField(const std::string& name, int /*lineNumber*/) {
+        begin();
+
+        writeIndent(depth + 1);
+        *output << name << " \"";
+    }
+
+    void SoffitStreamWriter::fieldChunk(const char* data, size_t length) {
+        _writeEscaped(*output, data, data + length);
+    }
+
+    void SoffitStreamWriter::endField(int /*lineNumber*/) {
+        *output << "\"\n";
+    }
+
+    void SoffitStreamWriter::endDocument(int lineNumber) {
+        begin();
+
+        if (depth != 0)
+            throw SoffitException("SOFFIT footer encountered in non-root object.", lineNumber);
+
+        *output << SOFFIT_END << "\n";
+        started = false;
+    }
+
+    void SoffitStreamWriter::field(const std::string& name, std::istream& source) {
+        std::vector<char> buffer(64 * 1024);
+
+        startField(name);
+        while (source) {
+            source.read(buffer.data(), (std::streamsize) buffer.size());
+            std::streamsize length = source.gcount();
+            if (length <= 0)
+                break;
+
+            fieldChunk(buffer.data(), (size_t) length);
+        }
+        endField();
+    }
+}
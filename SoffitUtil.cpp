@@ -35,54 +35,179 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stack>
 #include <vector>
 #include <stdexcept>
+#include <charconv>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
 
 namespace CPPSoffit {
 
-    const std::string SOFFIT_START = "__SoffitStart";
-    const std::string SOFFIT_END = "__SoffitEnd";
-    const char ESCAPE_SEQUENCE = '\\';
+    // Runs the non-throwing parser, recording the parse in the stats registry when it is enabled
+    static SoffitParseResult _tryReadStream(std::istream& stream, SoffitValidator* validator, const SoffitProjection* projection = nullptr, const SoffitLimits* limits = nullptr) {
+        SoffitError error;
+        SoffitObject* root;
+
+        if (!SoffitStatsRegistry::isEnabled()) {
+            root = _readStream(stream, validator, nullptr, error, projection, limits);
+        }
+        else {
+            SoffitStats stats;
+            root = _readStream(stream, validator, &stats, error, projection, limits);
+            if (root != nullptr)
+                SoffitStatsRegistry::record("read", stats);
+        }
+
+        if (root == nullptr)
+            return SoffitParseResult(std::move(error));
+
+        return SoffitParseResult(root);
+    }
+
+    SoffitParseResult TryReadStream(std::istream& stream) {
+        return _tryReadStream(stream, nullptr);
+    }
+
+    SoffitParseResult TryReadStream(std::istream& stream, const SoffitSchema& schema) {
+        SoffitValidator validator(&schema);
+        return _tryReadStream(stream, &validator);
+    }
+
+    SoffitParseResult TryReadStream(std::istream& stream, const SoffitProjection& projection) {
+        return _tryReadStream(stream, nullptr, &projection);
+    }
+
+    SoffitParseResult TryReadStream(std::istream& stream, const SoffitLimits& limits) {
+        return _tryReadStream(stream, nullptr, nullptr, &limits);
+    }
+
+    SoffitParseResult TryReadStreamFromString(std::string& stream) {
+        std::istringstream iss(stream);
+        return TryReadStream(iss);
+    }
 
     SoffitObject* ReadStream(std::istream& stream) {
-        int lineNumber = 0;
+        SoffitParseResult result = TryReadStream(stream);
+        if (!result.ok())
+            throw SoffitException(result.getError());
 
-        SoffitObject* root = new SoffitObject("", "");
+        return result.release();
+    }
 
-        std::string header = _getLine(stream, lineNumber);
-        if (header != SOFFIT_START)
-            throw SoffitException("SOFFIT header not found.");
+    SoffitObject* ReadStream(std::istream& stream, SoffitStats& stats) {
+        stats = SoffitStats();
+        SoffitError error;
+        SoffitObject* root = _readStream(stream, nullptr, &stats, error);
+        if (root == nullptr)
+            throw SoffitException(error);
 
-        _parseObject(stream, root, lineNumber);
+        if (SoffitStatsRegistry::isEnabled())
+            SoffitStatsRegistry::record("read", stats);
 
         return root;
     }
 
+    SoffitObject* ReadStream(std::istream& stream, const SoffitSchema& schema) {
+        SoffitParseResult result = TryReadStream(stream, schema);
+        if (!result.ok())
+            throw SoffitException(result.getError());
+
+        return result.release();
+    }
+
+    SoffitObject* ReadStream(std::istream& stream, const SoffitProjection& projection) {
+        SoffitParseResult result = TryReadStream(stream, projection);
+        if (!result.ok())
+            throw SoffitException(result.getError());
+
+        return result.release();
+    }
+
+    SoffitObject* ReadStream(std::istream& stream, const SoffitLimits& limits) {
+        SoffitParseResult result = TryReadStream(stream, limits);
+        if (!result.ok())
+            throw SoffitException(result.getError());
+
+        return result.release();
+    }
+
     SoffitObject* FindInStream(std::istream& stream, std::string type, std::string name) {
-        int lineNumber = 0;
+        if (!SoffitStatsRegistry::isEnabled()) {
+            SoffitError error;
+            SoffitObject* foundObject = _findStream(stream, type, name, nullptr, error);
+            if (foundObject == nullptr)
+                throw SoffitException(error);
 
-        SoffitObject* root = new SoffitObject("", "");
+            return foundObject;
+        }
+
+        SoffitStats stats;
+        return FindInStream(stream, type, name, stats);
+    }
 
-        std::string header = _getLine(stream, lineNumber);
-        if (header != SOFFIT_START)
-            throw SoffitException("SOFFIT header not found.");
+    SoffitObject* FindInStream(std::istream& stream, std::string type, std::string name, SoffitStats& stats) {
+        stats = SoffitStats();
+        SoffitError error;
+        SoffitObject* foundObject = _findStream(stream, type, name, &stats, error);
+        if (foundObject == nullptr)
+            throw SoffitException(error);
 
-        SoffitObject* foundObject = _findInStream(stream, root, lineNumber, type, name);
-        if(foundObject == nullptr)
-            throw SoffitException("Requested SOFFIT object not found in 'FindInStream' call.");
+        if (SoffitStatsRegistry::isEnabled())
+            SoffitStatsRegistry::record("find", stats);
 
         return foundObject;
     }
 
     void WriteStream(SoffitObject* root, std::ostream& output, bool indent) {
+        if (!SoffitStatsRegistry::isEnabled()) {
+            _writeStream(root, output, indent, nullptr);
+            return;
+        }
+
+        SoffitStats stats;
+        WriteStream(root, output, stats, indent);
+    }
+
+    void WriteStreamCached(SoffitObject* root, std::ostream& output, bool indent) {
+        const std::string& body = root->serializedBody(indent);
+
         output << SOFFIT_START << "\n";
-        _writeObjects(root, output, indent);
+        output.write(body.data(), body.size());
         output << SOFFIT_END << "\n";
     }
 
+    void WriteStream(SoffitObject* root, std::ostream& output, SoffitStats& stats, bool indent) {
+        stats = SoffitStats();
+        _writeStream(root, output, indent, &stats);
+
+        if (SoffitStatsRegistry::isEnabled())
+            SoffitStatsRegistry::record("write", stats);
+    }
+
     SoffitObject* ReadStreamFromString(std::string& stream) {
         std::istringstream iss(stream);
         return ReadStream(iss);
     }
 
+    SoffitObject* ReadStreamFromString(std::string& stream, const SoffitSchema& schema) {
+        std::istringstream iss(stream);
+        return ReadStream(iss, schema);
+    }
+
+    SoffitObject* ReadStreamFromString(std::string& stream, const SoffitProjection& projection) {
+        std::istringstream iss(stream);
+        return ReadStream(iss, projection);
+    }
+
+    SoffitObject* ReadStreamFromString(std::string& stream, const SoffitLimits& limits) {
+        std::istringstream iss(stream);
+        return ReadStream(iss, limits);
+    }
+
     std::string WriteStreamToString(SoffitObject* root, bool indent) {
         std::ostringstream oss;
         WriteStream(root, oss, indent);
@@ -93,10 +218,78 @@ namespace CPPSoffit {
     //*********BEGIN INTERNAL IMPLEMENTATION**********
     //************************************************
 
-    void _writeObjects(SoffitObject* object, std::ostream& output, bool indent) {
+    // Returns nullptr, with error filled in, if the stream is malformed.  Never throws, and never leaks the partial tree
+    SoffitObject* _readStream(std::istream& stream, SoffitValidator* validator, SoffitStats* stats, SoffitError& error, const SoffitProjection* projection, const SoffitLimits* limits) {
+        int lineNumber = 0;
+
+        std::string header;
+        SoffitBudget budget;
+        if (limits) {
+            budget = SoffitBudget(*limits);
+            if (!_getLine(stream, lineNumber, header, stats, budget, error))
+                return nullptr;
+        }
+        else {
+            _getLine(stream, lineNumber, header, stats);
+        }
+
+        if (header != SOFFIT_START) {
+            _fail(error, SoffitErrorCode::HeaderNotFound, "SOFFIT header not found.");
+            return nullptr;
+        }
+
+        SoffitObject* root = new SoffitObject("", "");
+        if (!_parseObject(stream, root, lineNumber, error, validator, stats, projection, limits ? &budget : nullptr)) {
+            delete root;
+            return nullptr;
+        }
+
+        return root;
+    }
+
+    SoffitObject* _findStream(std::istream& stream, std::string type, std::string name, SoffitStats* stats, SoffitError& error) {
+        int lineNumber = 0;
+
+        std::string header = _getLine(stream, lineNumber, stats);
+        if (header != SOFFIT_START) {
+            _fail(error, SoffitErrorCode::HeaderNotFound, "SOFFIT header not found.");
+            return nullptr;
+        }
+
+        SoffitObject* root = new SoffitObject("", "");
+        SoffitObject* foundObject = _findInStream(stream, root, lineNumber, type, name, error, stats);
+        if (foundObject == nullptr) {
+            if (error.code == SoffitErrorCode::None)
+                _fail(error, SoffitErrorCode::ObjectNotFound, "Requested SOFFIT object not found in 'FindInStream' call.");
+            delete root;
+        }
+
+        return foundObject;
+    }
+
+    void _writeStream(SoffitObject* root, std::ostream& output, bool indent, SoffitStats* stats) {
+        std::chrono::steady_clock::time_point mark;
+        if (SOFFIT_STATS_ON(stats))
+            mark = std::chrono::steady_clock::now();
+
+        output << SOFFIT_START << "\n";
+        _writeObjects(root, output, indent, stats);
+        output << SOFFIT_END << "\n";
+
+        if (SOFFIT_STATS_ON(stats)) {
+            stats->bytesWritten += SOFFIT_START.size() + SOFFIT_END.size() + 2;
+            _statsLap(stats, &SoffitStats::writeSeconds, mark);
+        }
+    }
+
+    void _writeObjects(SoffitObject* object, std::ostream& output, bool indent, SoffitStats* stats) {
+        //Each getter returns a copy, so take it once rather than on every iteration
+        std::vector<SoffitField*> fields = object->getAllFields();
+        std::vector<SoffitObject*> objects = object->getAllObjects();
+
         // Write fields
-        for (size_t i = 0; i < object->getAllFields().size(); i++) {
-            SoffitField* field = object->getAllFields()[i];
+        for (size_t i = 0; i < fields.size(); i++) {
+            SoffitField* field = fields[i];
 
             //Set indentation
             if (indent) {
@@ -105,15 +298,30 @@ namespace CPPSoffit {
             }
 
             output << field->getName();
-            if (field->getValue() != "")
-                output << " " << "\"" << _convertToEscapeSequence(field->getValue()) << "\"\n";
-            else
+            if (field->getValue() != "") {
+                output << " " << "\"";
+                _writeEscaped(output, field->getValue());
+                output << "\"\n";
+
+                if (SOFFIT_STATS_ON(stats)) {
+                    size_t length = _escapedLength(field->getValue());
+                    stats->bytesWritten += length + 3;
+                    stats->escapeSequencesEncoded += length - field->getValue().size();
+                }
+            }
+            else {
                 output << "\n";
+            }
+
+            if (SOFFIT_STATS_ON(stats)) {
+                stats->fieldsWritten++;
+                stats->bytesWritten += (indent ? field->getNestingLevel() : 0) + field->getName().size() + 1;
+            }
         }
 
         // Write nested objects
-        for (int i = 0; i < object->getAllObjects().size(); i++) {
-            SoffitObject* currentObject = object->getAllObjects()[i];
+        for (size_t i = 0; i < objects.size(); i++) {
+            SoffitObject* currentObject = objects[i];
 
             //Set indentation
             if (indent) {
@@ -122,72 +330,217 @@ namespace CPPSoffit {
             }
 
             output << currentObject->getType();
-            if (currentObject->getName() != "")
-                output << " " << "\"" << _convertToEscapeSequence(currentObject->getName()) << "\" {\n";
-            else
+            if (currentObject->getName() != "") {
+                output << " " << "\"";
+                _writeEscaped(output, currentObject->getName());
+                output << "\" {\n";
+
+                if (SOFFIT_STATS_ON(stats)) {
+                    size_t length = _escapedLength(currentObject->getName());
+                    stats->bytesWritten += length + 3;
+                    stats->escapeSequencesEncoded += length - currentObject->getName().size();
+                }
+            }
+            else {
                 output << " {\n";
+            }
 
-            _writeObjects(currentObject, output, indent);
+            _writeObjects(currentObject, output, indent, stats);
 
             if (indent) {
                 for (int i = 0; i < currentObject->getNestingLevel(); i++)
                     output << "\t";
             }
             output << "}\n";
+
+            if (SOFFIT_STATS_ON(stats)) {
+                stats->objectsWritten++;
+                stats->bytesWritten += (indent ? 2 * currentObject->getNestingLevel() : 0) + currentObject->getType().size() + 5;
+            }
         }
     }
 
-    // Parse an individual SOFFIT object and its contents from the stream
-    void _parseObject(std::istream& stream, SoffitObject* parent, int lineNumber) {
-        std::stack<SoffitObject*> stack;
-        stack.push(parent);
+    // Parse an individual SOFFIT object and its contents from the stream.  Returns false, with error filled in, if the stream is malformed
+    bool _parseObject(std::istream& stream, SoffitObject* parent, int lineNumber, SoffitError& error, SoffitValidator* validator, SoffitStats* stats, const SoffitProjection* projection, SoffitBudget* budget) {
+        std::vector<SoffitObject*> stack;
+        stack.push_back(parent);
+
+        //Objects the projection drops sit on the stack as null entries, keeping only their opening line.  They are
+        //built, by decoding that line, once something beneath them is kept, so that kept objects stay in place.  Their
+        //fields are skipped either way.  Entries below `built` have been built, and entries from `pendingCount` on
+        //are spare, kept so that their lines reuse their capacity
+        struct PendingObject {
+            size_t depth;
+            int lineNumber;
+            std::string line;
+        };
+        std::vector<PendingObject> pending;
+        size_t pendingCount = 0;
+        size_t built = 0;
+
+        std::chrono::steady_clock::time_point mark;
+        if (SOFFIT_STATS_ON(stats))
+            mark = std::chrono::steady_clock::now();
+
+        std::string line;
+        std::vector<std::string> tokens;
+        std::string fieldName;
 
         while (!stack.empty()) {
-            SoffitObject* currentObject = stack.top();
-            std::string line = _getLine(stream, lineNumber);
+            SoffitObject* currentObject = stack.back();
+            if (!budget)
+                _getLine(stream, lineNumber, line, stats);
+            else if (!_getLine(stream, lineNumber, line, stats, *budget, error))
+                return false;
+
+            if (SOFFIT_STATS_ON(stats))
+                _statsLap(stats, &SoffitStats::ioSeconds, mark);
 
             if (line.empty()) {
-                throw SoffitException("Incomplete SOFFIT stream.");
+                return _fail(error, SoffitErrorCode::IncompleteStream, "Incomplete SOFFIT stream.");
+            }
+
+            //Lines the projection drops are recognised before they are tokenized or decoded
+            if (projection) {
+                SoffitLineKind kind = _classifyLine(line.data(), line.data() + line.size());
+                bool inPending = pendingCount > 0 && pending[pendingCount - 1].depth == stack.size() - 1;
+
+                if (kind == SoffitLineKind::Field) {
+                    if (inPending)
+                        continue;
+                    fieldName.assign(line, 0, line.find(' '));
+                    if (!projection->keepsField(fieldName))
+                        continue;
+                }
+                else if (kind == SoffitLineKind::Close && inPending) {
+                    pendingCount--;
+                    if (built > pendingCount)
+                        built = pendingCount;
+                    stack.pop_back();
+                    continue;
+                }
+                else if (kind == SoffitLineKind::Object) {
+                    fieldName.assign(line, 0, line.find(' '));
+                    if (!projection->keepsType(fieldName)) {
+                        if (budget && stack.size() > budget->depth)
+                            return _fail(error, SoffitErrorCode::LimitExceeded, "SOFFIT objects nested too deeply.", lineNumber);
+
+                        if (pendingCount == pending.size())
+                            pending.emplace_back();
+                        PendingObject& dropped = pending[pendingCount++];
+                        dropped.depth = stack.size();
+                        dropped.lineNumber = lineNumber;
+                        dropped.line.assign(line);
+                        stack.push_back(nullptr);
+                        continue;
+                    }
+                }
             }
 
-            std::vector<std::string> tokens = _getLineTokens(line, lineNumber);
+            _getLineTokens(line, tokens);
+
+            if (SOFFIT_STATS_ON(stats))
+                _statsLap(stats, &SoffitStats::tokenizeSeconds, mark);
 
             //Ensure there are no double quotes in first token (The first token would be an object type or field name)
             if (_containsCharacter(tokens[0], '"'))
-                throw SoffitException("SOFFIT syntax error.", lineNumber);
+                return _fail(error, SoffitErrorCode::SyntaxError, "SOFFIT syntax error.", lineNumber);
 
             // Handle various tokens
             if (tokens.size() == 1 && tokens[0] == "}") {
                 if (!currentObject->isRoot()) {
-                    stack.pop();
+                    if (validator && !validator->exitObject(lineNumber, error))
+                        return false;
+                    stack.pop_back();
                 }
                 else {
-                    throw SoffitException("Too many closing brackets.", lineNumber);
+                    return _fail(error, SoffitErrorCode::TooManyClosingBrackets, "Too many closing brackets.", lineNumber);
                 }
                 //Handle footer
             }
             else if (tokens[0] == SOFFIT_END) {
-                if (!currentObject->isRoot()) {
-                    throw SoffitException("SOFFIT footer encountered in non-root object.", lineNumber);
+                if (!currentObject || !currentObject->isRoot()) {
+                    return _fail(error, SoffitErrorCode::FooterInObject, "SOFFIT footer encountered in non-root object.", lineNumber);
                 }
+                if (validator && !validator->exitObject(lineNumber, error))
+                    return false;
                 break;
                 //Handle object
             }
             else if (_isObject(tokens)) {
-                SoffitObject* newObject;
+                //Check the depth and node budgets before the object is built
+                if (budget) {
+                    if (stack.size() > budget->depth)
+                        return _fail(error, SoffitErrorCode::LimitExceeded, "SOFFIT objects nested too deeply.", lineNumber);
+                    if (budget->nodes == 0)
+                        return _fail(error, SoffitErrorCode::LimitExceeded, "SOFFIT stream has too many objects and fields.", lineNumber);
+                    budget->nodes--;
+                }
 
                 std::string objType = tokens[0];
-                if (tokens.size() == 2) {
-                    newObject = new SoffitObject(objType);
+                std::string objName;
+                if (tokens.size() > 2) {
+                    objName = _stripQuotations(tokens[1]);
+
+                    if (SOFFIT_STATS_ON(stats))
+                        _statsLap(stats, &SoffitStats::buildSeconds, mark);
+                    if (!_convertFromEscapeSequenceInPlace(objName, lineNumber, error, stats))
+                        return false;
+                    if (SOFFIT_STATS_ON(stats))
+                        _statsLap(stats, &SoffitStats::unescapeSeconds, mark);
+
+                    if (budget && objName.size() > budget->valueSize)
+                        return _fail(error, SoffitErrorCode::LimitExceeded, "SOFFIT object name is too long.", lineNumber);
                 }
-                else {
-                    std::string objName = _stripQuotations(tokens[1]);
-                    objName = _convertFromEscapeSequence(objName, lineNumber);
-                    newObject = new SoffitObject(objType, objName);
+
+                if (projection) {
+                    if (!projection->keepsObject(objType, objName)) {
+                        if (pendingCount == pending.size())
+                            pending.emplace_back();
+                        PendingObject& dropped = pending[pendingCount++];
+                        dropped.depth = stack.size();
+                        dropped.lineNumber = lineNumber;
+                        dropped.line.assign(line);
+                        stack.push_back(nullptr);
+                        continue;
+                    }
+
+                    //Build the dropped objects this one sits in, from their opening lines
+                    for (; built < pendingCount; built++) {
+                        PendingObject& dropped = pending[built];
+                        _getLineTokens(dropped.line, tokens);
+
+                        std::string ancestorName;
+                        if (tokens.size() > 2) {
+                            ancestorName = _stripQuotations(tokens[1]);
+                            if (!_convertFromEscapeSequenceInPlace(ancestorName, dropped.lineNumber, error, stats))
+                                return false;
+                        }
+
+                        SoffitObject* ancestor = new SoffitObject(tokens[0], std::move(ancestorName));
+                        stack[dropped.depth - 1]->add(ancestor);
+                        stack[dropped.depth] = ancestor;
+
+                        if (SOFFIT_STATS_ON(stats))
+                            stats->objectsCreated++;
+                    }
+                    currentObject = stack.back();
                 }
 
+                SoffitObject* newObject = new SoffitObject(std::move(objType), std::move(objName));
+
                 currentObject->add(newObject);
-                stack.push(newObject);
+                stack.push_back(newObject);
+
+                if (SOFFIT_STATS_ON(stats)) {
+                    stats->objectsCreated++;
+                    if (stack.size() - 1 > stats->maxDepth)
+                        stats->maxDepth = stack.size() - 1;
+                    _statsLap(stats, &SoffitStats::buildSeconds, mark);
+                }
+
+                if (validator && !validator->enterObject(newObject->getType(), newObject->getName(), lineNumber, error))
+                    return false;
                 //Handle field
             }
             else if (_isField(tokens)) {
@@ -198,34 +551,74 @@ namespace CPPSoffit {
                 if (tokens.size() > 1)
                     fieldValue = _stripQuotations(tokens[1]);
 
-                fieldValue = _convertFromEscapeSequence(fieldValue, lineNumber);
+                if (SOFFIT_STATS_ON(stats))
+                    _statsLap(stats, &SoffitStats::buildSeconds, mark);
+                if (!_convertFromEscapeSequenceInPlace(fieldValue, lineNumber, error, stats))
+                    return false;
+                if (SOFFIT_STATS_ON(stats))
+                    _statsLap(stats, &SoffitStats::unescapeSeconds, mark);
+
+                if (budget) {
+                    if (fieldValue.size() > budget->valueSize)
+                        return _fail(error, SoffitErrorCode::LimitExceeded, "SOFFIT field value is too long.", lineNumber);
+                    if (budget->nodes == 0)
+                        return _fail(error, SoffitErrorCode::LimitExceeded, "SOFFIT stream has too many objects and fields.", lineNumber);
+                    budget->nodes--;
+                }
+
+                if (validator && !validator->field(fieldName, fieldValue, lineNumber, error))
+                    return false;
+
                 currentObject->add(new SoffitField(fieldName, fieldValue));
+
+                if (SOFFIT_STATS_ON(stats)) {
+                    stats->fieldsCreated++;
+                    _statsLap(stats, &SoffitStats::buildSeconds, mark);
+                }
             }
             else {
-                throw SoffitException("SOFFIT syntax error.", lineNumber);
+                return _fail(error, SoffitErrorCode::SyntaxError, "SOFFIT syntax error.", lineNumber);
             }
         }
+
+        return true;
     }
 
-    SoffitObject* _findInStream(std::istream& stream, SoffitObject* parent, int lineNumber, std::string type, std::string name) {
+    SoffitObject* _findInStream(std::istream& stream, SoffitObject* parent, int lineNumber, std::string type, std::string name, SoffitError& error, SoffitStats* stats) {
         SoffitObject* foundObject = nullptr;
 
         std::stack<SoffitObject*> stack;
         stack.push(parent);
 
+        std::chrono::steady_clock::time_point mark;
+        if (SOFFIT_STATS_ON(stats))
+            mark = std::chrono::steady_clock::now();
+
+        std::string line;
+        std::vector<std::string> tokens;
+
         while (!stack.empty()) {
             SoffitObject* currentObject = stack.top();
-            std::string line = _getLine(stream, lineNumber);
+            _getLine(stream, lineNumber, line, stats);
+
+            if (SOFFIT_STATS_ON(stats))
+                _statsLap(stats, &SoffitStats::ioSeconds, mark);
 
             if (line.empty()) {
-                throw SoffitException("Incomplete SOFFIT stream.");
+                _fail(error, SoffitErrorCode::IncompleteStream, "Incomplete SOFFIT stream.");
+                return nullptr;
             }
 
-            std::vector<std::string> tokens = _getLineTokens(line, lineNumber);
+            _getLineTokens(line, tokens);
+
+            if (SOFFIT_STATS_ON(stats))
+                _statsLap(stats, &SoffitStats::tokenizeSeconds, mark);
 
             //Ensure there are no double quotes in first token (The first token would be an object type or field name)
-            if (_containsCharacter(tokens[0], '"'))
-                throw SoffitException("SOFFIT syntax error.", lineNumber);
+            if (_containsCharacter(tokens[0], '"')) {
+                _fail(error, SoffitErrorCode::SyntaxError, "SOFFIT syntax error.", lineNumber);
+                return nullptr;
+            }
 
             // Handle various tokens
             if (tokens.size() == 1 && tokens[0] == "}") {
@@ -239,13 +632,15 @@ namespace CPPSoffit {
                     }
                 }
                 else {
-                    throw SoffitException("Too many closing brackets.", lineNumber);
+                    _fail(error, SoffitErrorCode::TooManyClosingBrackets, "Too many closing brackets.", lineNumber);
+                    return nullptr;
                 }
                 //Handle footer
             }
             else if (tokens[0] == SOFFIT_END) {
                 if (!currentObject->isRoot()) {
-                    throw SoffitException("SOFFIT footer encountered in non-root object.", lineNumber);
+                    _fail(error, SoffitErrorCode::FooterInObject, "SOFFIT footer encountered in non-root object.", lineNumber);
+                    return nullptr;
                 }
                 break;
                 //Handle object
@@ -259,12 +654,26 @@ namespace CPPSoffit {
                 }
                 else {
                     std::string objName = _stripQuotations(tokens[1]);
-                    objName = _convertFromEscapeSequence(objName, lineNumber);
+
+                    if (SOFFIT_STATS_ON(stats))
+                        _statsLap(stats, &SoffitStats::buildSeconds, mark);
+                    if (!_convertFromEscapeSequenceInPlace(objName, lineNumber, error, stats))
+                        return nullptr;
+                    if (SOFFIT_STATS_ON(stats))
+                        _statsLap(stats, &SoffitStats::unescapeSeconds, mark);
+
                     newObject = new SoffitObject(objType, objName);
                 }
 
                 currentObject->add(newObject);
                 stack.push(newObject);
+
+                if (SOFFIT_STATS_ON(stats)) {
+                    stats->objectsCreated++;
+                    if (stack.size() - 1 > stats->maxDepth)
+                        stats->maxDepth = stack.size() - 1;
+                    _statsLap(stats, &SoffitStats::buildSeconds, mark);
+                }
                 //Handle field
             }
             else if (_isField(tokens)) {
@@ -275,11 +684,22 @@ namespace CPPSoffit {
                 if (tokens.size() > 1)
                     fieldValue = _stripQuotations(tokens[1]);
 
-                fieldValue = _convertFromEscapeSequence(fieldValue, lineNumber);
+                if (SOFFIT_STATS_ON(stats))
+                    _statsLap(stats, &SoffitStats::buildSeconds, mark);
+                if (!_convertFromEscapeSequenceInPlace(fieldValue, lineNumber, error, stats))
+                    return nullptr;
+                if (SOFFIT_STATS_ON(stats))
+                    _statsLap(stats, &SoffitStats::unescapeSeconds, mark);
                 currentObject->add(new SoffitField(fieldName, fieldValue));
+
+                if (SOFFIT_STATS_ON(stats)) {
+                    stats->fieldsCreated++;
+                    _statsLap(stats, &SoffitStats::buildSeconds, mark);
+                }
             }
             else {
-                throw SoffitException("SOFFIT syntax error.", lineNumber);
+                _fail(error, SoffitErrorCode::SyntaxError, "SOFFIT syntax error.", lineNumber);
+                return nullptr;
             }
         }
 
@@ -287,198 +707,559 @@ namespace CPPSoffit {
         return nullptr;
     }
 
+    // Unset limits are left at their largest value, so that every check is a single comparison
+    SoffitBudget::SoffitBudget(const SoffitLimits& limits) {
+        if (limits.maxLineLength)
+            lineLength = limits.maxLineLength;
+        if (limits.maxDepth)
+            depth = limits.maxDepth;
+        if (limits.maxNodes)
+            nodes = limits.maxNodes;
+        if (limits.maxBytes)
+            bytes = limits.maxBytes;
+        if (limits.maxValueSize)
+            valueSize = limits.maxValueSize;
+    }
+
+    // Records an error for the non-throwing parser, returning false so that it can be returned directly
+    bool _fail(SoffitError& error, SoffitErrorCode code, const std::string& message, int lineNumber) {
+        error.code = code;
+        error.message = message;
+        error.lineNumber = lineNumber;
+        return false;
+    }
+
     void _cleanObject(SoffitObject* root, SoffitObject* objToBeCleaned) {
         objToBeCleaned->detachFromParant();
         delete root;
     }
 
-    std::vector<std::string> _getLineTokens(std::string& line, int lineNumber) {
-        std::vector<std::string> tokens;
-        std::string currentToken = "";
+    // Skip the body of an object whose opening line has already been read
+    void _skipObject(std::istream& stream, int& lineNumber) {
+        std::string line;
+        SoffitError error;
+        if (!_skipObject(stream, lineNumber, line, error))
+            throw SoffitException(error);
+    }
 
-        int mark = 0;
-        bool insideQuotes = false;
+    // Skip the body of an object by counting brackets, without tokenizing lines or decoding escape sequences
+    bool _skipObject(std::istream& stream, int& lineNumber, std::string& line, SoffitError& error, SoffitStats* stats) {
+        int depth = 1;
 
-        for (int i = 0; i < line.size(); i++) {
-            if (line[i] == '"') {
-                //Check for escape sequence inside a quoted area
-                if (insideQuotes) {
-                    //an array bounds problem in this case indicates a soffit syntax error
-                    if (i - 1 < 0)
-                        throw SoffitException("SOFFIT syntax error.", lineNumber);
+        while (depth > 0) {
+            _getLine(stream, lineNumber, line, stats);
 
-                    if (line[i - 1] != '\\') {
-                        insideQuotes = !insideQuotes;
-                    }
-                }
-                else {
+            if (line.empty())
+                return _fail(error, SoffitErrorCode::IncompleteStream, "Incomplete SOFFIT stream.");
+
+            SoffitLineKind kind = _classifyLine(line.data(), line.data() + line.size());
+            if (kind == SoffitLineKind::Close)
+                depth--;
+            else if (kind == SoffitLineKind::Object)
+                depth++;
+            else if (kind == SoffitLineKind::Footer)
+                return _fail(error, SoffitErrorCode::FooterInObject, "SOFFIT footer encountered in non-root object.", lineNumber);
+            else if (kind == SoffitLineKind::Invalid)
+                return _fail(error, SoffitErrorCode::SyntaxError, "SOFFIT syntax error.", lineNumber);
+        }
+
+        return true;
+    }
+
+    // Find the next significant line within a buffer, following the same rules as _getLine
+    bool _nextLine(const char* data, size_t& pos, size_t end, int& lineNumber, size_t& lineBegin, size_t& lineEnd) {
+        while (pos < end) {
+            lineNumber++;
+
+            size_t start = pos;
+            while (pos < end && data[pos] != '\n' && data[pos] != '\r')
+                pos++;
+            size_t stop = pos;
+
+            //Step over the line terminator
+            if (pos < end)
+                pos++;
+
+            //Strip leading and trailing whitespace
+            while (start < stop && (data[start] == ' ' || data[start] == '\t'))
+                start++;
+            while (stop > start && (data[stop - 1] == ' ' || data[stop - 1] == '\t'))
+                stop--;
+
+            //Check for blank line or comment
+            if (start == stop || data[start] == '#')
+                continue;
+
+            lineBegin = start;
+            lineEnd = stop;
+            return true;
+        }
+
+        return false;
+    }
+
+    // Classify a stripped line without allocating, using the same token rules as _getLineTokens, _isObject and _isField
+    SoffitLineKind _classifyLine(const char* begin, const char* end) {
+        const char* tokenBegin[3] = { nullptr, nullptr, nullptr };
+        const char* tokenEnd[3] = { nullptr, nullptr, nullptr };
+        int tokenCount = 0;
+        bool inToken = false;
+        bool insideQuotes = false;
+
+        for (const char* c = begin; c < end; c++) {
+            if (*c == '"') {
+                if (!insideQuotes || *(c - 1) != '\\')
                     insideQuotes = !insideQuotes;
-                }
             }
 
+            if (*c == ' ' && !insideQuotes) {
+                if (inToken && tokenCount <= 3)
+                    tokenEnd[tokenCount - 1] = c;
+                inToken = false;
+            }
+            else if (!inToken) {
+                inToken = true;
+                tokenCount++;
+                if (tokenCount <= 3)
+                    tokenBegin[tokenCount - 1] = c;
+            }
+        }
+        if (inToken && tokenCount <= 3)
+            tokenEnd[tokenCount - 1] = end;
+
+        //Ensure there are no double quotes in first token (The first token would be an object type or field name)
+        for (const char* c = tokenBegin[0]; c < tokenEnd[0]; c++) {
+            if (*c == '"')
+                return SoffitLineKind::Invalid;
+        }
+
+        size_t firstLength = tokenEnd[0] - tokenBegin[0];
+        if (tokenCount == 1 && firstLength == 1 && *tokenBegin[0] == '}')
+            return SoffitLineKind::Close;
+
+        if (firstLength == SOFFIT_END.size() && SOFFIT_END.compare(0, firstLength, tokenBegin[0], firstLength) == 0)
+            return SoffitLineKind::Footer;
+
+        if (tokenCount == 2 && tokenEnd[1] - tokenBegin[1] == 1 && *tokenBegin[1] == '{')
+            return SoffitLineKind::Object;
+
+        if (tokenCount == 3 && *tokenBegin[1] == '"' && *(tokenEnd[1] - 1) == '"')
+            return SoffitLineKind::Object;
+
+        if (tokenCount == 1 || (tokenCount == 2 && *tokenBegin[1] == '"'))
+            return SoffitLineKind::Field;
+
+        return SoffitLineKind::Invalid;
+    }
+
+    std::vector<std::string> _getLineTokens(std::string& line, int lineNumber) {
+        std::vector<std::string> tokens;
+        _getLineTokens(line, tokens);
+        return tokens;
+    }
+
+    // Split a line into tokens, reusing the strings already held by tokens
+    void _getLineTokens(const std::string& line, std::vector<std::string>& tokens) {
+        tokens.resize(_tokenizeLine(line, tokens));
+    }
+
+    // Surplus strings past the returned count are left in place so their buffers can be reused by later lines
+    size_t _tokenizeLine(const std::string& line, std::vector<std::string>& tokens) {
+        size_t count = 0;
+        size_t tokenBegin = 0;
+        bool inToken = false;
+        bool insideQuotes = false;
+
+        for (size_t i = 0; i < line.size(); i++) {
+            //A closing quote can not be at the start of the line, so line[i - 1] is always valid here
+            if (line[i] == '"' && (!insideQuotes || line[i - 1] != '\\'))
+                insideQuotes = !insideQuotes;
+
             if (line[i] == ' ' && !insideQuotes) {
-                if (!currentToken.empty()) {
-                    tokens.push_back(currentToken);
-                    currentToken.clear();
+                if (inToken) {
+                    if (count < tokens.size())
+                        tokens[count].assign(line, tokenBegin, i - tokenBegin);
+                    else
+                        tokens.emplace_back(line, tokenBegin, i - tokenBegin);
+                    count++;
+                    inToken = false;
                 }
             }
-            else {
-                currentToken += line[i];
+            else if (!inToken) {
+                tokenBegin = i;
+                inToken = true;
             }
         }
 
-        if (!currentToken.empty()) {
-            tokens.push_back(currentToken);
+        if (inToken) {
+            if (count < tokens.size())
+                tokens[count].assign(line, tokenBegin, line.size() - tokenBegin);
+            else
+                tokens.emplace_back(line, tokenBegin, line.size() - tokenBegin);
+            count++;
         }
 
-        return tokens;
+        return count;
     }
 
-    std::string _getLine(std::istream& stream, int& lineNumber) {
+    std::string _getLine(std::istream& stream, int& lineNumber, SoffitStats* stats) {
+        std::string line;
+        _getLine(stream, lineNumber, line, stats);
+        return line;
+    }
+
+    // Read the next significant line into line, reusing its capacity.  line is left empty at the end of the stream
+    void _getLine(std::istream& stream, int& lineNumber, std::string& line, SoffitStats* stats) {
+        SoffitBudget budget;
+        SoffitError error;
+        _getLine(stream, lineNumber, line, stats, budget, error);
+    }
+
+    // As _getLine, charging every byte read to budget.  Returns false, with error filled in,
+    // before a line longer than the budget allows is stored
+    bool _getLine(std::istream& stream, int& lineNumber, std::string& line, SoffitStats* stats, SoffitBudget& budget, SoffitError& error) {
         while (true) {
             bool eos = false;
-            std::string line = "";
+            line.clear();
             lineNumber++;
 
+            //A single bound covers both the line length and the bytes left, so the loop checks once per character
+            uint64_t cap = budget.lineLength < budget.bytes ? budget.lineLength : budget.bytes;
+
             while (true) {
+                int c = stream.get();
 
-                //try {
-                    int c = stream.get();
+                //Check for EOS;
+                if (c == -1) {
+                    eos = true;
+                    break;
+                }
 
-                    //Check for EOS;
-                    if (c == -1) {
-                        eos = true;
-                        break;
-                    }
+                if (SOFFIT_STATS_ON(stats))
+                    stats->bytesRead++;
 
-                    //Check for new line
-                    if (c == (int)'\n')
-                        break;
-                    if (c == (int)'\r')
-                        break;
+                //Check for new line
+                if (c == (int)'\n')
+                    break;
+                if (c == (int)'\r')
+                    break;
 
-                    line.append(1, (char) c);
+                if (line.size() == cap) {
+                    if (cap == budget.lineLength)
+                        return _fail(error, SoffitErrorCode::LimitExceeded, "SOFFIT line is too long.", lineNumber);
+                    return _fail(error, SoffitErrorCode::LimitExceeded, "SOFFIT stream is too large.", lineNumber);
+                }
 
-                //}
-                //catch (IOException e) {
-                    //Explicitly return null
-                    //return null;
-                //}
+                line.push_back((char) c);
             }
 
-            line = _stripWhitespace(line);
+            //Charge the line and its terminator to the byte budget
+            uint64_t consumed = line.size() + (eos ? 0 : 1);
+            if (consumed > budget.bytes)
+                return _fail(error, SoffitErrorCode::LimitExceeded, "SOFFIT stream is too large.", lineNumber);
+            budget.bytes -= consumed;
 
-            //Check for EOS and essentially a null line
-            if (eos && line.length() == 0)
-                return "";
+            //Strip leading and trailing whitespace in place
+            size_t end = line.find_last_not_of(" \t");
+            if (end == std::string::npos) {
+                line.clear();
+            }
+            else {
+                line.erase(end + 1);
+                line.erase(0, line.find_first_not_of(" \t"));
+            }
 
-            //Return if EOS is reached
+            if (SOFFIT_STATS_ON(stats))
+                stats->linesRead++;
+
+            //Return if EOS is reached, with an empty line if there was nothing left
             if (eos)
-                return line;
+                return true;
 
             //Check for blank line
-            if (line.empty())
+            if (line.empty()) {
+                if (SOFFIT_STATS_ON(stats))
+                    stats->blankLinesSkipped++;
                 continue;
+            }
 
             //Check for comments
-            if (line.at(0) == '#')
+            if (line[0] == '#') {
+                if (SOFFIT_STATS_ON(stats))
+                    stats->commentLinesSkipped++;
                 continue;
+            }
 
-            //if (line != null)
-                return line;
-        }
-
-        /*
-        std::string line;
-
-        while (std::getline(stream, line)) {
-            lineNumber++;
-            line = _stripWhitespace(line);
-            if (line.empty() || line[0] == '#')
-                continue; // Skip blank or comment lines
-
-            return line;
+            return true;
         }
-        return "";
-        */
     }
 
     //Check if the tokens represent a SOFFIT object
     bool _isObject(std::vector<std::string>& tokens) {
-        return (tokens.size() == 2 && tokens[1] == "{") || (tokens.size() == 3 && tokens[1][0] == '"' && tokens[1].back() == '"');
+        return _isObject(tokens, tokens.size());
+    }
+
+    //As _isObject, for token buffers that may hold unused strings past count
+    bool _isObject(const std::vector<std::string>& tokens, size_t count) {
+        return (count == 2 && tokens[1] == "{") || (count == 3 && tokens[1][0] == '"' && tokens[1].back() == '"');
     }
 
     //Check if the tokens represent a SOFFIT field
     bool _isField(std::vector<std::string>& tokens) {
-        return tokens.size() == 1 || (tokens.size() == 2 && tokens[1][0] == '"');
+        return _isField(tokens, tokens.size());
     }
 
-    std::string _convertFromEscapeSequence(const std::string& s, int lineNumber) {
-        std::string result = "";
-
-        for (int i = 0; i < s.size(); i++) {
-            if (s[i] == '\\') {
+    bool _isField(const std::vector<std::string>& tokens, size_t count) {
+        return count == 1 || (count == 2 && tokens[1][0] == '"');
+    }
 
-                //double quote
-                if (s[i + 1] == '"') {
-                    result += '"';
-                    i++;
-                    continue;
-                }
+    // Find the next character that has to be escaped, checking 16 bytes at a time where SSE2 is available
+    const char* _findEscapeCharacter(const char* begin, const char* end) {
+        const char* p = begin;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i newline = _mm_set1_epi8('\n');
+        const __m128i backslash = _mm_set1_epi8('\\');
+
+        while (end - p >= 16) {
+            __m128i chunk = _mm_loadu_si128((const __m128i*) p);
+            __m128i matches = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, newline)),
+                _mm_cmpeq_epi8(chunk, backslash));
+
+            unsigned int mask = (unsigned int) _mm_movemask_epi8(matches);
+            if (mask != 0) {
+#if defined(_MSC_VER)
+                unsigned long index;
+                _BitScanForward(&index, mask);
+                return p + index;
+#else
+                return p + __builtin_ctz(mask);
+#endif
+            }
+            p += 16;
+        }
+#endif
 
-                //Newline
-                if (s[i + 1] == 'n') {
-                    result += '\n';
-                    i++;
-                    continue;
-                }
+        for (; p < end; p++) {
+            if (*p == '"' || *p == '\n' || *p == '\\')
+                return p;
+        }
+        return end;
+    }
 
-                //Backslash
-                if (s[i + 1] == '\\') {
-                    result += '\\';
-                    i++;
-                    continue;
-                }
+    void _convertFromEscapeSequenceInPlace(std::string& s, int lineNumber, SoffitStats* stats) {
+        SoffitError error;
+        if (!_convertFromEscapeSequenceInPlace(s, lineNumber, error, stats))
+            throw SoffitException(error);
+    }
 
-                throw SoffitException("Invalid escape sequence", lineNumber);
-            }
-            else {
-                result += s[i];
+    bool _convertFromEscapeSequenceInPlace(std::string& s, int lineNumber, SoffitError& error, SoffitStats* stats) {
+        size_t size = s.size();
+        const char* firstEscape = (const char*) std::memchr(s.data(), '\\', size);
+
+        //Nothing to decode, leave the string untouched
+        if (firstEscape == nullptr)
+            return true;
+
+        char* data = &s[0];
+        size_t read = firstEscape - data;
+        size_t write = read;
+        uint64_t decoded = 0;
+
+        while (read < size) {
+            //read is always at a backslash here
+            if (read + 1 >= size)
+                return _fail(error, SoffitErrorCode::InvalidEscapeSequence, "Invalid escape sequence", lineNumber);
+
+            switch (data[read + 1]) {
+            case '"': data[write++] = '"'; break;
+            case 'n': data[write++] = '\n'; break;
+            case '\\': data[write++] = '\\'; break;
+            default: return _fail(error, SoffitErrorCode::InvalidEscapeSequence, "Invalid escape sequence", lineNumber);
             }
+            read += 2;
+            decoded++;
+
+            //Move the clean run up to the next escape sequence in one go
+            const char* next = (const char*) std::memchr(data + read, '\\', size - read);
+            size_t runEnd = next != nullptr ? next - data : size;
+            std::memmove(data + write, data + read, runEnd - read);
+            write += runEnd - read;
+            read = runEnd;
         }
 
+        s.resize(write);
+
+        if (SOFFIT_STATS_ON(stats))
+            stats->escapeSequencesDecoded += decoded;
+
+        return true;
+    }
+
+    std::string _convertFromEscapeSequence(const std::string& s, int lineNumber, SoffitStats* stats) {
+        std::string result = s;
+        _convertFromEscapeSequenceInPlace(result, lineNumber, stats);
         return result;
     }
 
+    size_t _escapedLength(const std::string& s) {
+        const char* p = s.data();
+        const char* end = p + s.size();
+        size_t length = s.size();
+
+        while ((p = _findEscapeCharacter(p, end)) != end) {
+            length++;
+            p++;
+        }
+
+        return length;
+    }
+
+    // Returns the escape sequence that replaces one of the characters found by _findEscapeCharacter
+    static const char* _escapeSequenceFor(char c) {
+        if (c == '"')
+            return "\\\"";
+        if (c == '\n')
+            return "\\n";
+        return "\\\\";
+    }
+
     std::string _convertToEscapeSequence(const std::string& s) {
-        std::string result = "";
+        size_t length = _escapedLength(s);
+        if (length == s.size())
+            return s;
 
-        for (char c : s) {
-            //Double quote correction
-            if (c == '"') {
-                result += "\\\"";
-                continue;
-            }
+        std::string result;
+        result.resize(length);
 
-            //Newline correction
-            if (c == '\n') {
-                result += "\\n";
-                continue;
-            }
+        const char* p = s.data();
+        const char* end = p + s.size();
+        char* out = &result[0];
 
-            //Backslash correction
-            if (c == ESCAPE_SEQUENCE) {
-                result += "\\\\";
-                continue;
-            }
+        while (p < end) {
+            const char* special = _findEscapeCharacter(p, end);
+            std::memcpy(out, p, special - p);
+            out += special - p;
+
+            if (special == end)
+                break;
 
-            //Add all normal characters
-            result += c;
+            std::memcpy(out, _escapeSequenceFor(*special), 2);
+            out += 2;
+            p = special + 1;
         }
 
         return result;
     }
 
+    void _writeEscaped(std::ostream& output, const std::string& s) {
+        _writeEscaped(output, s.data(), s.data() + s.size());
+    }
+
+    void _writeEscaped(std::ostream& output, const char* begin, const char* end) {
+        const char* p = begin;
+
+        while (p < end) {
+            const char* special = _findEscapeCharacter(p, end);
+            output.write(p, special - p);
+
+            if (special == end)
+                break;
+
+            output.write(_escapeSequenceFor(*special), 2);
+            p = special + 1;
+        }
+    }
+
+    // As _writeEscaped, appending to a string
+    void _appendEscaped(std::string& output, const std::string& s) {
+        const char* p = s.data();
+        const char* end = p + s.size();
+
+        while (p < end) {
+            const char* special = _findEscapeCharacter(p, end);
+            output.append(p, special - p);
+
+            if (special == end)
+                break;
+
+            output.append(_escapeSequenceFor(*special), 2);
+            p = special + 1;
+        }
+    }
+
+    bool _parseInteger(const std::string& s, int64_t& out) {
+        const char* end = s.data() + s.size();
+        std::from_chars_result r = std::from_chars(s.data(), end, out);
+        return !s.empty() && r.ec == std::errc() && r.ptr == end;
+    }
+
+    bool _parseDouble(const std::string& s, double& out) {
+        const char* end = s.data() + s.size();
+        std::from_chars_result r = std::from_chars(s.data(), end, out);
+        return !s.empty() && r.ec == std::errc() && r.ptr == end;
+    }
+
+    bool _parseBool(const std::string& s, bool& out) {
+        if (s == "true" || s == "1") {
+            out = true;
+            return true;
+        }
+
+        if (s == "false" || s == "0") {
+            out = false;
+            return true;
+        }
+
+        return false;
+    }
+
+    std::string _formatInteger(int64_t v) {
+        char buffer[24];
+        std::to_chars_result r = std::to_chars(buffer, buffer + sizeof(buffer), v);
+        return std::string(buffer, r.ptr);
+    }
+
+    std::string _formatDouble(double v) {
+        char buffer[32];
+        std::to_chars_result r = std::to_chars(buffer, buffer + sizeof(buffer), v);
+        return std::string(buffer, r.ptr);
+    }
+
+    // 64-bit FNV-1a.  Fixed, rather than std::hash, so that hashes are stable across builds and platforms
+    uint64_t _hashString(const std::string& s) {
+        return _hashBytes(s.data(), s.size());
+    }
+
+    // Passing the result of an earlier call as hash continues it, so a hash can be built up over several buffers
+    uint64_t _hashBytes(const char* data, size_t length, uint64_t hash) {
+        for (size_t i = 0; i < length; i++) {
+            hash ^= (uint8_t) data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Order-dependent combination, finished with the splitmix64 mixer
+    uint64_t _hashCombine(uint64_t seed, uint64_t value) {
+        uint64_t z = seed * 0x9e3779b97f4a7c15ull + value;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // Bytes a string has allocated outside of itself.  Short strings are stored inline and allocate nothing
+    size_t _heapUsage(const std::string& s) {
+        const char* data = s.data();
+        const char* self = (const char*) &s;
+        if (data >= self && data < self + sizeof(std::string))
+            return 0;
+
+        return s.capacity() + 1;
+    }
+
     std::string _stripQuotations(std::string& s) {
         return s.substr(1, s.size() - 2);
     }
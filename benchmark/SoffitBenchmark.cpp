@@ -0,0 +1,377 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+ * Benchmarks for the CPPSoffit read/write paths and lookup methods.
+ *
+ * Results are written as CSV, one row per benchmark:
+ *     name,bytes,nodes,iterations,seconds,mb_per_s,nodes_per_s,allocs_per_node,peak_rss_kb
+ * bytes and nodes are per iteration, and seconds is the mean time of one iteration.
+ *
+ * A previous run can be given with --baseline to flag benchmarks whose throughput dropped by more than --tolerance percent.
+ * The process exits with 1 if any regression is found.
+ */
+
+#include "../CPPSoffit.h"
+#include "SoffitCorpus.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <new>
+#include <sstream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+//**************************************
+//******** ALLOCATION COUNTING *********
+//**************************************
+
+static std::atomic<uint64_t> allocationCount(0);
+
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size != 0 ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size != 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+namespace {
+    using namespace CPPSoffit;
+
+    struct Options {
+        size_t corpusBytes = 4 * 1024 * 1024;
+        double minSeconds = 0.5;
+        std::string shape = "";
+        std::string output = "";
+        std::string baseline = "";
+        double tolerance = 10.0;
+        std::string corpusDirectory = "";
+    };
+
+    struct Result {
+        std::string name;
+        size_t bytes;
+        size_t nodes;
+        int iterations;
+        double seconds;
+        double allocationsPerIteration;
+        long peakRssKb;
+    };
+
+    long peakRssKb() {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters;
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return (long) (counters.PeakWorkingSetSize / 1024);
+        return 0;
+#else
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+#endif
+    }
+
+    size_t countNodes(SoffitObject* object) {
+        size_t count = object->getAllFields().size();
+
+        std::vector<SoffitObject*> children = object->getAllObjects();
+        for (size_t i = 0; i < children.size(); i++)
+            count += 1 + countNodes(children[i]);
+
+        return count;
+    }
+
+    //Runs body until at least minSeconds have passed.  setup runs before each iteration and is not timed.
+    Result measure(const std::string& name, size_t bytes, size_t nodes, double minSeconds,
+        const std::function<void()>& setup, const std::function<void()>& body) {
+        typedef std::chrono::steady_clock Clock;
+
+        int iterations = 0;
+        double elapsed = 0.0;
+        uint64_t allocations = 0;
+
+        while (iterations == 0 || elapsed < minSeconds) {
+            setup();
+
+            uint64_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+            Clock::time_point start = Clock::now();
+            body();
+            Clock::time_point stop = Clock::now();
+
+            allocations += allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+            elapsed += std::chrono::duration<double>(stop - start).count();
+            iterations++;
+        }
+
+        return { name, bytes, nodes, iterations, elapsed / iterations, (double) allocations / iterations, peakRssKb() };
+    }
+
+    void benchmarkShape(SoffitCorpusShape shape, const Options& options, std::vector<Result>& results) {
+        std::string shapeName = SoffitCorpusShapeName(shape);
+        std::string corpus = GenerateSoffitCorpus(shape, options.corpusBytes);
+
+        if (!options.corpusDirectory.empty()) {
+            std::ofstream file(options.corpusDirectory + "/" + shapeName + ".soffit", std::ios::binary);
+            file << corpus;
+        }
+
+        SoffitObject* root = ReadStreamFromString(corpus);
+        size_t nodes = countNodes(root);
+        size_t items = root->getObjectsByType("Item").size();
+        std::string lastItem = "item-" + std::to_string(items - 1);
+        auto noSetup = []() {};
+
+        results.push_back(measure("ReadStream/" + shapeName, corpus.size(), nodes, options.minSeconds,
+            noSetup,
+            [&]() {
+                std::istringstream iss(corpus);
+                delete ReadStream(iss);
+            }));
+
+        results.push_back(measure("ReadStreamFromString/" + shapeName, corpus.size(), nodes, options.minSeconds,
+            noSetup,
+            [&]() { delete ReadStreamFromString(corpus); }));
+
+        results.push_back(measure("ReadStreamLazy/" + shapeName, corpus.size(), nodes, options.minSeconds,
+            noSetup,
+            [&]() { delete ReadStreamFromStringLazy(corpus); }));
+
+        results.push_back(measure("FindInStream/" + shapeName, corpus.size(), nodes, options.minSeconds,
+            noSetup,
+            [&]() {
+                std::istringstream iss(corpus);
+                delete FindInStream(iss, "Item", lastItem);
+            }));
+
+        std::string written = WriteStreamToString(root);
+
+        results.push_back(measure("WriteStream/" + shapeName, written.size(), nodes, options.minSeconds,
+            noSetup,
+            [&]() {
+                std::ostringstream oss;
+                WriteStream(root, oss);
+            }));
+
+        results.push_back(measure("WriteStreamToString/" + shapeName, written.size(), nodes, options.minSeconds,
+            noSetup,
+            [&]() { WriteStreamToString(root); }));
+
+        results.push_back(measure("WriteStreamToString.noindent/" + shapeName, written.size(), nodes, options.minSeconds,
+            noSetup,
+            [&]() { WriteStreamToString(root, false); }));
+
+        //Lookups are measured per query, so nodes is the number of queries and bytes is 0
+        std::vector<SoffitObject*> children = root->getAllObjects();
+        const size_t queries = 1000;
+
+        results.push_back(measure("Lookup.getObject/" + shapeName, 0, queries, options.minSeconds,
+            noSetup,
+            [&]() {
+                for (size_t i = 0; i < queries; i++)
+                    root->getObject("item-" + std::to_string((i * 7919) % items));
+            }));
+
+        results.push_back(measure("Lookup.getObjectByTypeAndName/" + shapeName, 0, queries, options.minSeconds,
+            noSetup,
+            [&]() {
+                for (size_t i = 0; i < queries; i++)
+                    root->getObjectByTypeAndName("Item", "item-" + std::to_string((i * 7919) % items));
+            }));
+
+        results.push_back(measure("Lookup.getObjectsByType/" + shapeName, 0, queries, options.minSeconds,
+            noSetup,
+            [&]() {
+                for (size_t i = 0; i < queries; i++)
+                    root->getObjectsByType("Item");
+            }));
+
+        results.push_back(measure("Lookup.getField/" + shapeName, 0, queries, options.minSeconds,
+            noSetup,
+            [&]() {
+                for (size_t i = 0; i < queries; i++)
+                    children[(i * 7919) % children.size()]->getField("Field3");
+            }));
+
+        delete root;
+    }
+
+    void writeResults(const std::vector<Result>& results, std::ostream& output) {
+        output << "name,bytes,nodes,iterations,seconds,mb_per_s,nodes_per_s,allocs_per_node,peak_rss_kb\n";
+
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& r = results[i];
+            char row[512];
+            std::snprintf(row, sizeof(row), "%s,%zu,%zu,%d,%.9f,%.3f,%.1f,%.3f,%ld\n",
+                r.name.c_str(), r.bytes, r.nodes, r.iterations, r.seconds,
+                r.bytes / (1024.0 * 1024.0) / r.seconds,
+                r.nodes / r.seconds,
+                r.nodes > 0 ? r.allocationsPerIteration / r.nodes : 0.0,
+                r.peakRssKb);
+            output << row;
+        }
+    }
+
+    //Reads seconds per iteration, keyed by benchmark name, from a previous CSV report
+    std::map<std::string, double> readBaseline(const std::string& path) {
+        std::map<std::string, double> baseline;
+        std::ifstream file(path);
+        std::string line;
+
+        std::getline(file, line);
+        while (std::getline(file, line)) {
+            std::vector<std::string> columns;
+            std::stringstream ss(line);
+            std::string column;
+            while (std::getline(ss, column, ','))
+                columns.push_back(column);
+
+            if (columns.size() >= 5)
+                baseline[columns[0]] = std::atof(columns[4].c_str());
+        }
+
+        return baseline;
+    }
+
+    bool compareBaseline(const std::vector<Result>& results, const Options& options) {
+        std::map<std::string, double> baseline = readBaseline(options.baseline);
+        bool regressed = false;
+
+        for (size_t i = 0; i < results.size(); i++) {
+            std::map<std::string, double>::iterator previous = baseline.find(results[i].name);
+            if (previous == baseline.end() || previous->second <= 0.0)
+                continue;
+
+            double change = (results[i].seconds / previous->second - 1.0) * 100.0;
+            if (change > options.tolerance) {
+                std::fprintf(stderr, "REGRESSION %s: %.1f%% slower than baseline\n", results[i].name.c_str(), change);
+                regressed = true;
+            }
+            else if (change < -options.tolerance) {
+                std::fprintf(stderr, "IMPROVEMENT %s: %.1f%% faster than baseline\n", results[i].name.c_str(), -change);
+            }
+        }
+
+        return !regressed;
+    }
+
+    void printUsage() {
+        std::fprintf(stderr,
+            "Usage: soffit_benchmark [options]\n"
+            "  --size BYTES        Size of each generated document (default 4194304)\n"
+            "  --min-time SECONDS  Minimum time spent on each benchmark (default 0.5)\n"
+            "  --shape NAME        Only run one corpus shape (wide, deep, long-values, escape-heavy, comment-heavy, crlf)\n"
+            "  --output FILE       Write the CSV report to FILE instead of stdout\n"
+            "  --baseline FILE     Compare against a previous CSV report\n"
+            "  --tolerance PERCENT Slowdown allowed before a benchmark counts as a regression (default 10)\n"
+            "  --write-corpus DIR  Also write each generated document to DIR\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--size" && hasValue)
+            options.corpusBytes = (size_t) std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--min-time" && hasValue)
+            options.minSeconds = std::atof(argv[++i]);
+        else if (arg == "--shape" && hasValue)
+            options.shape = argv[++i];
+        else if (arg == "--output" && hasValue)
+            options.output = argv[++i];
+        else if (arg == "--baseline" && hasValue)
+            options.baseline = argv[++i];
+        else if (arg == "--tolerance" && hasValue)
+            options.tolerance = std::atof(argv[++i]);
+        else if (arg == "--write-corpus" && hasValue)
+            options.corpusDirectory = argv[++i];
+        else {
+            printUsage();
+            return 2;
+        }
+    }
+
+    std::vector<Result> results;
+    for (SoffitCorpusShape shape : ALL_CORPUS_SHAPES) {
+        if (options.shape.empty() || options.shape == SoffitCorpusShapeName(shape))
+            benchmarkShape(shape, options, results);
+    }
+
+    if (options.output.empty()) {
+        writeResults(results, std::cout);
+    }
+    else {
+        std::ofstream file(options.output);
+        writeResults(results, file);
+    }
+
+    if (!options.baseline.empty() && !compareBaseline(results, options))
+        return 1;
+
+    return 0;
+}
@@ -0,0 +1,227 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "SoffitCorpus.h"
+
+namespace CPPSoffit {
+
+    namespace {
+        //xorshift32, so that output does not depend on the standard library's random engines
+        class CorpusRandom {
+        private:
+            uint32_t state;
+
+        public:
+            CorpusRandom(uint32_t seed) {
+                state = seed != 0 ? seed : 1;
+            }
+
+            uint32_t next() {
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+                return state;
+            }
+
+            uint32_t next(uint32_t bound) {
+                return next() % bound;
+            }
+        };
+
+        const char* const WORDS[] = {
+            "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel",
+            "india", "juliet", "kilo", "lima", "mike", "november", "oscar", "papa"
+        };
+        const int WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+
+        void appendText(std::string& out, CorpusRandom& random, size_t length, bool escapes) {
+            size_t start = out.size();
+            while (out.size() - start < length) {
+                if (escapes) {
+                    switch (random.next(4)) {
+                    case 0: out += "\\\""; break;
+                    case 1: out += "\\n"; break;
+                    case 2: out += "\\\\"; break;
+                    default: break;
+                    }
+                }
+
+                out += WORDS[random.next(WORD_COUNT)];
+                out += ' ';
+            }
+            out.pop_back();
+        }
+
+        void appendIndent(std::string& out, int depth) {
+            out.append(depth, '\t');
+        }
+
+        void appendItem(std::string& out, CorpusRandom& random, size_t index, const char* newline) {
+            out += "Item \"item-";
+            out += std::to_string(index);
+            out += "\" {";
+            out += newline;
+
+            for (int i = 0; i < 5; i++) {
+                appendIndent(out, 1);
+                out += "Field";
+                out += std::to_string(i);
+                out += " \"";
+                appendText(out, random, 8 + random.next(24), false);
+                out += "\"";
+                out += newline;
+            }
+
+            out += "}";
+            out += newline;
+        }
+
+        void generateWide(std::string& out, CorpusRandom& random, size_t targetBytes, const char* newline) {
+            out += "Version \"1.0\"";
+            out += newline;
+
+            for (size_t i = 0; out.size() < targetBytes; i++)
+                appendItem(out, random, i, newline);
+        }
+
+        void generateDeep(std::string& out, CorpusRandom& random, size_t targetBytes) {
+            const int chainDepth = 64;
+
+            for (size_t i = 0; out.size() < targetBytes; i++) {
+                out += "Item \"item-" + std::to_string(i) + "\" {\n";
+
+                for (int depth = 1; depth < chainDepth; depth++) {
+                    appendIndent(out, depth);
+                    out += "Level \"";
+                    appendText(out, random, 4 + random.next(12), false);
+                    out += "\"\n";
+                    appendIndent(out, depth);
+                    out += "Node {\n";
+                }
+
+                for (int depth = chainDepth - 1; depth > 0; depth--) {
+                    appendIndent(out, depth);
+                    out += "}\n";
+                }
+                out += "}\n";
+            }
+        }
+
+        void generateLongValues(std::string& out, CorpusRandom& random, size_t targetBytes) {
+            for (size_t i = 0; out.size() < targetBytes; i++) {
+                out += "Item \"item-" + std::to_string(i) + "\" {\n";
+                out += "\tPayload \"";
+                appendText(out, random, 4096 + random.next(60 * 1024), false);
+                out += "\"\n}\n";
+            }
+        }
+
+        void generateEscapeHeavy(std::string& out, CorpusRandom& random, size_t targetBytes) {
+            for (size_t i = 0; out.size() < targetBytes; i++) {
+                out += "Item \"item-" + std::to_string(i) + "\" {\n";
+
+                out += "\tEscaped \"";
+                appendText(out, random, 16, true);
+                out += "\" {\n";
+                for (int f = 0; f < 4; f++) {
+                    out += "\t\tText \"";
+                    appendText(out, random, 32 + random.next(96), true);
+                    out += "\"\n";
+                }
+                out += "\t}\n}\n";
+            }
+        }
+
+        void generateCommentHeavy(std::string& out, CorpusRandom& random, size_t targetBytes) {
+            for (size_t i = 0; out.size() < targetBytes; i++) {
+                out += "# Item ";
+                out += std::to_string(i);
+                out += "\n\n";
+                out += "Item \"item-" + std::to_string(i) + "\" {\n";
+
+                for (int f = 0; f < 5; f++) {
+                    out += "\t# ";
+                    appendText(out, random, 24 + random.next(40), false);
+                    out += "\n\n";
+                    out += "\tField" + std::to_string(f) + " \"";
+                    appendText(out, random, 8 + random.next(24), false);
+                    out += "\"\n";
+                }
+                out += "}\n";
+            }
+        }
+    }
+
+    const char* SoffitCorpusShapeName(SoffitCorpusShape shape) {
+        switch (shape) {
+        case SoffitCorpusShape::Wide: return "wide";
+        case SoffitCorpusShape::Deep: return "deep";
+        case SoffitCorpusShape::LongValues: return "long-values";
+        case SoffitCorpusShape::EscapeHeavy: return "escape-heavy";
+        case SoffitCorpusShape::CommentHeavy: return "comment-heavy";
+        case SoffitCorpusShape::Crlf: return "crlf";
+        }
+        return "unknown";
+    }
+
+    std::string GenerateSoffitCorpus(SoffitCorpusShape shape, size_t targetBytes, uint32_t seed) {
+        CorpusRandom random(seed);
+        std::string out;
+        out.reserve(targetBytes + 64 * 1024);
+
+        const char* newline = shape == SoffitCorpusShape::Crlf ? "\r\n" : "\n";
+        out += "__SoffitStart";
+        out += newline;
+
+        switch (shape) {
+        case SoffitCorpusShape::Wide:
+        case SoffitCorpusShape::Crlf:
+            generateWide(out, random, targetBytes, newline);
+            break;
+        case SoffitCorpusShape::Deep:
+            generateDeep(out, random, targetBytes);
+            break;
+        case SoffitCorpusShape::LongValues:
+            generateLongValues(out, random, targetBytes);
+            break;
+        case SoffitCorpusShape::EscapeHeavy:
+            generateEscapeHeavy(out, random, targetBytes);
+            break;
+        case SoffitCorpusShape::CommentHeavy:
+            generateCommentHeavy(out, random, targetBytes);
+            break;
+        }
+
+        out += "__SoffitEnd";
+        out += newline;
+        return out;
+    }
+}
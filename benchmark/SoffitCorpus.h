@@ -0,0 +1,70 @@
+/*
+BSD 3-Clause License
+
+Copyright (c) 2024, Noah McLean
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its
+   contributors may be used to endorse or promote products derived from
+   this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include <string>
+#include <cstdint>
+
+/**
+ * Deterministic generator for representative SOFFIT documents, used by the benchmarks.
+ * The same shape, size and seed always produce byte-identical output.
+ */
+namespace CPPSoffit {
+
+    enum class SoffitCorpusShape {
+        Wide,           //Many small objects attached directly to the root
+        Deep,           //Long chains of nested objects
+        LongValues,     //Few fields holding multi-kilobyte values
+        EscapeHeavy,    //Values and names dense with \", \n and \\ escape sequences
+        CommentHeavy,   //Comments and blank lines between most properties
+        Crlf            //The Wide shape with CRLF line endings
+    };
+
+    const SoffitCorpusShape ALL_CORPUS_SHAPES[] = {
+        SoffitCorpusShape::Wide,
+        SoffitCorpusShape::Deep,
+        SoffitCorpusShape::LongValues,
+        SoffitCorpusShape::EscapeHeavy,
+        SoffitCorpusShape::CommentHeavy,
+        SoffitCorpusShape::Crlf
+    };
+
+    /**
+     * Returns a short, file name safe name for a corpus shape.
+     */
+    const char* SoffitCorpusShapeName(SoffitCorpusShape shape);
+
+    /**
+     * Generates a complete SOFFIT stream of roughly targetBytes bytes.
+     * Top-level objects are of type "Item" and named "item-0", "item-1", and so on, so that they can be searched for.
+     */
+    std::string GenerateSoffitCorpus(SoffitCorpusShape shape, size_t targetBytes, uint32_t seed = 1);
+}